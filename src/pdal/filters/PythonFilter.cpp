@@ -35,12 +35,20 @@
 #include "../nlohmann/json.hpp"
 
 #include "PythonFilter.hpp"
+#include "../plang/Executor.hpp"
 
 #include <pdal/PointView.hpp>
+#include <pdal/StreamPointTable.hpp>
 #include <pdal/DimUtil.hpp>
 #include <pdal/util/ProgramArgs.hpp>
 #include <pdal/util/FileUtils.hpp>
 
+#include <atomic>
+#include <exception>
+#include <map>
+#include <thread>
+#include <unordered_map>
+
 #if defined(snprintf)
 #undef snprintf
 #endif
@@ -65,10 +73,40 @@ struct PythonFilter::Args
     std::string m_scriptFile;
     StringList m_addDimensions;
     NL::json m_pdalargs;
+    bool m_zeroCopy;
+    bool m_hugePages;
+    bool m_structured;
+    size_t m_threads;
+    point_count_t m_batchSize;
+    point_count_t m_chunkSize;
+    size_t m_workers;
+    size_t m_processes;
+    bool m_executor;
+    std::string m_cacheDir;
+    bool m_isolated;
+    StringList m_inputDims;
+    StringList m_outputDims;
+};
+
+// When streaming, points are copied from the stream table into a batch
+// table that supports views, so the function runs once per batch rather
+// than once per point.
+struct PythonFilter::Batch
+{
+    StreamPointTable *m_streamTable;
+    std::unique_ptr<PointTable> m_table;
+    PointViewPtr m_view;     // All points of the batch table, in order.
+    DimTypeList m_streamDims;
+    Dimension::IdList m_dims;    // Batch table IDs of m_streamDims.
+    PointIdList m_ids;      // Stream table IDs of the batch points.
+    std::vector<bool> m_keep;
+    size_t m_pos;       // Position in m_ids of the next point to be seen.
+    bool m_valid;
 };
 
 PythonFilter::PythonFilter() :
-    m_script(nullptr), m_pythonMethod(nullptr), m_args(new Args)
+    m_script(nullptr), m_pythonMethod(nullptr), m_args(new Args),
+    m_batch(new Batch)
 {}
 
 
@@ -93,6 +131,48 @@ void PythonFilter::addArgs(ProgramArgs& args)
     args.add("add_dimension", "Dimensions to add", m_args->m_addDimensions);
     args.add("pdalargs", "Dictionary to add to module globals when "
         "calling function", m_args->m_pdalargs);
+    args.add("zero_copy", "Pass contiguous point data to the function "
+        "without copying.  In-place changes to input arrays modify the "
+        "points.  Input arrays kept after the function returns are given "
+        "copies of their data, but slices and other views made from them "
+        "still refer to the points and mustn't be kept.",
+        m_args->m_zeroCopy);
+    args.add("structured", "Pass the points to the function as a single "
+        "structured array rather than a dictionary of arrays",
+        m_args->m_structured);
+    args.add("threads", "Number of threads used to copy point data to "
+        "and from arrays", m_args->m_threads, (size_t)1);
+    args.add("huge_pages", "Request huge pages for large array buffers",
+        m_args->m_hugePages);
+    args.add("batch_size", "Maximum number of points passed to the "
+        "function at once when streaming.  Default is the size of the "
+        "stream chunk.", m_args->m_batchSize, (point_count_t)0);
+    args.add("chunk_size", "Maximum number of points passed to the "
+        "function at once.  Larger views are passed in consecutive "
+        "slices.  Default is the whole view.", m_args->m_chunkSize,
+        (point_count_t)0);
+    args.add("workers", "Number of slices run at once when 'chunk_size' "
+        "is set.  With 'isolated', the module is run once for each worker.",
+        m_args->m_workers, (size_t)1);
+    args.add("processes", "Number of forked processes that run slices "
+        "at once when 'chunk_size' is set.  They're forked when first "
+        "needed and run every later slice, so module state they change "
+        "isn't seen by the pipeline.  Output printed by the function in "
+        "them isn't logged.", m_args->m_processes, (size_t)1);
+    args.add("executor", "Run the function on a single thread shared by "
+        "all pipelines in the process rather than on the pipeline's "
+        "thread", m_args->m_executor);
+    args.add("bytecode_cache", "Directory in which compiled code is "
+        "cached, so that later runs of the same source skip compiling it",
+        m_args->m_cacheDir);
+    args.add("isolated", "Run the module on its own rather than sharing it "
+        "with other stages in the process that run the same source.  "
+        "Shared modules run their top-level code once and share globals.",
+        m_args->m_isolated);
+    args.add("dimensions", "Dimensions passed to the function.  Default "
+        "is all dimensions.", m_args->m_inputDims);
+    args.add("output_dimensions", "Dimensions the function may set.  "
+        "Default is any dimension.", m_args->m_outputDims);
 }
 
 
@@ -126,6 +206,31 @@ void PythonFilter::prepared(PointTableRef table)
         throwError("Can't set both 'source' and 'script' options.");
     if (!m_args->m_source.size() && !m_args->m_scriptFile.size())
         throwError("Must set one of 'source' and 'script' options.");
+    if (m_args->m_workers > 1 && !m_args->m_chunkSize)
+        throwError("Option 'workers' requires 'chunk_size'.");
+    if (m_args->m_processes > 1 && !m_args->m_chunkSize)
+        throwError("Option 'processes' requires 'chunk_size'.");
+    if (m_args->m_processes > 1 && m_args->m_workers > 1)
+        throwError("Can't set both 'workers' and 'processes' options.");
+    if (m_args->m_executor && m_args->m_workers > 1)
+        throwError("Can't set both 'workers' and 'executor' options.");
+
+    // Use the layout's spelling of each dimension name, since that's
+    // how the arrays are keyed.
+    PointLayoutPtr layout(table.layout());
+    auto resolve = [this, &layout](StringList& dims, const std::string& opt)
+    {
+        for (std::string& name : dims)
+        {
+            Dimension::Id id = layout->findDim(name);
+            if (id == Dimension::Id::Unknown)
+                throwError("Invalid dimension '" + name + "' specified "
+                    "for '" + opt + "' option.");
+            name = layout->dimName(id);
+        }
+    };
+    resolve(m_args->m_inputDims, "dimensions");
+    resolve(m_args->m_outputDims, "output_dimensions");
 }
 
 
@@ -138,8 +243,68 @@ void PythonFilter::ready(PointTableRef table)
     env->set_stdout(out);
     m_script.reset(new plang::Script(m_args->m_source, m_args->m_module,
         m_args->m_function));
-	m_pythonMethod.reset(new plang::Invocation(*m_script, table.metadata(),
-        m_args->m_pdalargs.dump(1)));
+    m_pythonMethod.reset(newInvocation(table));
+
+    // Workers share the table, and processes copy it by row, which is
+    // only possible when it stores points by row.
+    m_workerMethods.clear();
+    m_processRunner.reset();
+    size_t workers = m_args->m_workers;
+    size_t processes = m_args->m_processes;
+    if ((workers > 1 || processes > 1) &&
+        !dynamic_cast<SimplePointTable *>(&table))
+    {
+        log()->get(LogLevel::Warning) << getName() << ": 'workers' and "
+            "'processes' ignored, since the point table doesn't store "
+            "points by row." << std::endl;
+        workers = 1;
+        processes = 1;
+    }
+    for (size_t i = 1; i < workers; ++i)
+        m_workerMethods.emplace_back(newInvocation(table));
+    if (processes > 1)
+        m_processRunner.reset(new plang::ProcessRunner(*m_pythonMethod,
+            processes));
+    prepareBatch(table);
+}
+
+
+plang::Invocation *PythonFilter::newInvocation(PointTableRef table)
+{
+    std::unique_ptr<plang::Invocation> method(new plang::Invocation(
+        *m_script, table.metadata(), m_args->m_pdalargs.dump(1),
+        m_args->m_cacheDir, m_args->m_isolated));
+    method->setZeroCopy(m_args->m_zeroCopy);
+    method->setHugePages(m_args->m_hugePages);
+    method->setStructured(m_args->m_structured);
+    method->setThreads(m_args->m_threads);
+    method->setInputDims(m_args->m_inputDims);
+    method->setOutputDims(m_args->m_outputDims);
+    return method.release();
+}
+
+
+void PythonFilter::prepareBatch(PointTableRef table)
+{
+    m_batch->m_streamTable = dynamic_cast<StreamPointTable *>(&table);
+    m_batch->m_valid = false;
+    if (!m_batch->m_streamTable)
+        return;
+
+    m_batch->m_table.reset(new PointTable);
+    PointLayoutPtr layout(table.layout());
+    PointLayoutPtr batchLayout(m_batch->m_table->layout());
+    m_batch->m_streamDims.clear();
+    m_batch->m_dims.clear();
+    for (Dimension::Id id : layout->dims())
+    {
+        Dimension::Type type = layout->dimType(id);
+        m_batch->m_streamDims.push_back(DimType(id, type));
+        m_batch->m_dims.push_back(batchLayout->registerOrAssignDim(
+            layout->dimName(id), type));
+    }
+    m_batch->m_table->finalize();
+    m_batch->m_view.reset(new PointView(*m_batch->m_table));
 }
 
 
@@ -148,17 +313,267 @@ PointViewSet PythonFilter::run(PointViewPtr view)
     log()->get(LogLevel::Debug5) << "filters.python " << *m_script <<
         " processing " << (int)view->size() << " points." << std::endl;
 
-    plang::gil_scoped_acquire acquire;
-    m_pythonMethod->execute(view, getMetadata());
+    if (!m_args->m_executor)
+        return runView(view);
+
+    PointViewSet viewSet;
+    plang::Executor::get().run([this, &view, &viewSet]()
+        { viewSet = runView(view); });
+    return viewSet;
+}
 
+
+PointViewSet PythonFilter::runView(PointViewPtr view)
+{
+    plang::gil_scoped_acquire acquire;
     PointViewSet viewSet;
-    viewSet.insert(view);
+    const point_count_t chunkSize = m_args->m_chunkSize;
+    if (!chunkSize || view->size() <= chunkSize)
+    {
+        m_pythonMethod->execute(view, getMetadata(), viewSet);
+        return viewSet;
+    }
+
+    // The results of each slice are gathered into one view, or one view
+    // per label if the function splits.  Buffers from the earlier slices
+    // have been released by then, so the pool hands them back out.
+    PointViewPtr kept;
+    std::map<int64_t, PointViewPtr> splits;
+    bool splitting = false;
+    std::vector<PointViewPtr> chunks;
+    for (PointId start = 0; start < view->size(); start += chunkSize)
+    {
+        const PointId end = (std::min)(start + chunkSize, view->size());
+        PointViewPtr chunk = view->makeNew();
+        for (PointId idx = start; idx < end; ++idx)
+            chunk->appendPoint(*view, idx);
+        chunks.push_back(chunk);
+    }
+    std::vector<PointViewSet> chunkSets(chunks.size());
+    std::vector<std::vector<int64_t>> chunkLabels(chunks.size());
+    runChunks(chunks, chunkSets, chunkLabels);
+
+    for (size_t i = 0; i < chunks.size(); ++i)
+    {
+        const PointViewSet& chunkSet = chunkSets[i];
+        const std::vector<int64_t>& labels = chunkLabels[i];
+
+        // Only a split can add a number of views other than one, and
+        // a split of one label reports it.
+        const bool split = labels.size() || chunkSet.size() != 1;
+        if (i && split != splitting)
+            throwError("The function must split every chunk of the view "
+                "or none of them.");
+        splitting = split;
+        if (!split)
+        {
+            if (!kept)
+                kept = view->makeNew();
+            PointViewPtr result = *chunkSet.begin();
+            for (PointId idx = 0; idx < result->size(); ++idx)
+                kept->appendPoint(*result, idx);
+            continue;
+        }
+
+        auto label = labels.begin();
+        for (const PointViewPtr& result : chunkSet)
+        {
+            PointViewPtr& out = splits[*label++];
+            if (!out)
+                out = view->makeNew();
+            for (PointId idx = 0; idx < result->size(); ++idx)
+                out->appendPoint(*result, idx);
+        }
+    }
+
+    if (kept)
+        viewSet.insert(kept);
+    for (auto& s : splits)
+        viewSet.insert(s.second);
     return viewSet;
 }
 
 
+// Runs the function on each slice, with as many slices at once as there
+// are invocations.  Each worker takes the next slice that hasn't been
+// started.  With a GIL, workers only overlap while numpy or the
+// marshaling code has released it.  Free-threaded builds run them fully
+// in parallel.
+void PythonFilter::runChunks(std::vector<PointViewPtr>& chunks,
+    std::vector<PointViewSet>& chunkSets,
+    std::vector<std::vector<int64_t>>& chunkLabels)
+{
+    std::atomic<size_t> next(0);
+    auto work = [&](plang::Invocation *method, MetadataNode metadata)
+    {
+        for (size_t i = next++; i < chunks.size(); i = next++)
+            method->execute(chunks[i], metadata, chunkSets[i],
+                &chunkLabels[i]);
+    };
+
+    if (m_processRunner && chunks.size() > 1)
+    {
+        m_processRunner->run(chunks, chunkSets, chunkLabels, getMetadata());
+        return;
+    }
+    if (m_workerMethods.empty() || chunks.size() == 1)
+    {
+        work(m_pythonMethod.get(), getMetadata());
+        return;
+    }
+
+    std::vector<plang::Invocation *> methods { m_pythonMethod.get() };
+    for (auto& m : m_workerMethods)
+        methods.push_back(m.get());
+    std::vector<std::exception_ptr> errors(methods.size());
+
+    // Metadata nodes aren't thread-safe, so each worker gets its own.
+    // They're added to the stage's metadata once the workers are done.
+    std::vector<MetadataNode> metadata;
+    for (size_t w = 0; w < methods.size(); ++w)
+        metadata.push_back(MetadataNode(getName()));
+    {
+        plang::gil_scoped_release release;
+
+        std::vector<std::thread> threads;
+        for (size_t w = 0; w < methods.size(); ++w)
+        {
+            plang::Invocation *method = methods[w];
+            MetadataNode node = metadata[w];
+            std::exception_ptr *error = &errors[w];
+            threads.push_back(std::thread([&, method, node, error]()
+            {
+                plang::gil_scoped_acquire acquire;
+                try
+                {
+                    work(method, node);
+                }
+                catch (...)
+                {
+                    // Stop handing out slices.
+                    *error = std::current_exception();
+                    next = chunks.size();
+                }
+            }));
+        }
+        for (std::thread& t : threads)
+            t.join();
+    }
+    for (std::exception_ptr& e : errors)
+        if (e)
+            std::rethrow_exception(e);
+    MetadataNode stageMetadata = getMetadata();
+    for (MetadataNode& node : metadata)
+        for (MetadataNode& child : node.children())
+            stageMetadata.add(child);
+}
+
+
+bool PythonFilter::processOne(PointRef& point)
+{
+    // Earlier filters have seen the whole chunk before this one sees any
+    // of it, so the points this one will see are known: those that none
+    // of them dropped.  Any other point is from a new chunk, and the batch
+    // is stale.
+    PointId id = point.pointId();
+    Batch& b = *m_batch;
+    if (!b.m_valid || b.m_pos >= b.m_ids.size() || id != b.m_ids[b.m_pos])
+        processBatch(id);
+    return b.m_keep[b.m_pos++];
+}
+
+
+// Runs the function on the points of the current chunk from 'start' on
+// that earlier filters haven't dropped, up to the batch size.
+void PythonFilter::processBatch(PointId start)
+{
+    Batch& b = *m_batch;
+    const point_count_t numPoints = b.m_streamTable->numPoints();
+    b.m_ids.clear();
+    for (PointId id = start; id < numPoints; ++id)
+    {
+        if (m_args->m_batchSize && b.m_ids.size() == m_args->m_batchSize)
+            break;
+        if (id == start || !b.m_streamTable->skip(id))
+            b.m_ids.push_back(id);
+    }
+    const point_count_t count = b.m_ids.size();
+
+    const size_t numDims = b.m_streamDims.size();
+    char buf[sizeof(double)];   // Large enough for any dimension.
+
+    // The batch table only grows to the largest batch.  Each batch reuses
+    // its points.
+    PointViewPtr view = b.m_view->makeNew();
+    PointRef src(*b.m_streamTable, start);
+    for (PointId i = 0; i < count; ++i)
+    {
+        src.setPointId(b.m_ids[i]);
+        for (size_t d = 0; d < numDims; ++d)
+        {
+            const DimType& dt = b.m_streamDims[d];
+            src.getField(buf, dt.m_id, dt.m_type);
+            b.m_view->setField(b.m_dims[d], dt.m_type, i, buf);
+        }
+        view->appendPoint(*b.m_view, i);
+    }
+
+    log()->get(LogLevel::Debug5) << "filters.python " << *m_script <<
+        " processing batch of " << (int)count << " points." << std::endl;
+
+    PointViewPtr result(view);
+    {
+        auto execute = [this, &result]()
+        {
+            plang::gil_scoped_acquire acquire;
+            m_pythonMethod->execute(result, getMetadata());
+        };
+        if (m_args->m_executor)
+            plang::Executor::get().run(execute);
+        else
+            execute();
+    }
+
+    // A mask or index list produces a new view of the batch points.  Its
+    // points are located by address to find which ones were kept.
+    b.m_keep.assign(count, false);
+    if (result == view)
+    {
+        if (result->size() != count)
+            throwError("Can't add points to a stream.");
+        b.m_keep.assign(count, true);
+    }
+    else
+    {
+        std::unordered_map<const char *, PointId> position;
+        for (PointId i = 0; i < count; ++i)
+            position[b.m_view->getPoint(i)] = i;
+        for (PointId i = 0; i < result->size(); ++i)
+            b.m_keep[position.at(result->getPoint(i))] = true;
+    }
+
+    for (PointId i = 0; i < count; ++i)
+    {
+        if (!b.m_keep[i])
+            continue;
+        src.setPointId(b.m_ids[i]);
+        for (size_t d = 0; d < numDims; ++d)
+        {
+            const DimType& dt = b.m_streamDims[d];
+            b.m_view->getField(buf, b.m_dims[d], dt.m_type, i);
+            src.setField(dt.m_id, dt.m_type, buf);
+        }
+    }
+
+    b.m_pos = 0;
+    b.m_valid = true;
+}
+
+
 void PythonFilter::done(PointTableRef table)
 {
+    // Stops the worker processes.
+    m_processRunner.reset();
     static_cast<plang::Environment*>(plang::Environment::get())->reset_stdout();
 }
 
@@ -36,14 +36,16 @@
 
 #include <pdal/Filter.hpp>
 #include <pdal/JsonFwd.hpp>
+#include <pdal/Streamable.hpp>
 
 #include "../plang/Invocation.hpp"
+#include "../plang/ProcessRunner.hpp"
 
 
 namespace pdal
 {
 
-class PDAL_DLL PythonFilter : public Filter
+class PDAL_DLL PythonFilter : public Filter, public Streamable
 {
 public:
     PythonFilter();
@@ -60,13 +62,26 @@ private:
     virtual void prepared(PointTableRef table);
     virtual void ready(PointTableRef table);
     virtual PointViewSet run(PointViewPtr view);
+    PointViewSet runView(PointViewPtr view);
+    virtual bool processOne(PointRef& point);
     virtual void done(PointTableRef table);
 
+    plang::Invocation *newInvocation(PointTableRef table);
+    void runChunks(std::vector<PointViewPtr>& chunks,
+        std::vector<PointViewSet>& chunkSets,
+        std::vector<std::vector<int64_t>>& chunkLabels);
+    void prepareBatch(PointTableRef table);
+    void processBatch(PointId start);
+
     std::unique_ptr<plang::Script> m_script;
     std::unique_ptr<plang::Invocation> m_pythonMethod;
+    std::vector<std::unique_ptr<plang::Invocation>> m_workerMethods;
+    std::unique_ptr<plang::ProcessRunner> m_processRunner;
 
     struct Args;
     std::unique_ptr<Args> m_args;
+    struct Batch;
+    std::unique_ptr<Batch> m_batch;
 };
 
 } // namespace pdal
@@ -0,0 +1,418 @@
+/******************************************************************************
+* Copyright (c) 2026, Hobu Inc. (info@hobu.co)
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following
+* conditions are met:
+*
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in
+*       the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of Hobu, Inc. or Flaxen Geo Consulting nor the
+*       names of its contributors may be used to endorse or promote
+*       products derived from this software without specific prior
+*       written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+* COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+* OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+* AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+* OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+* OF SUCH DAMAGE.
+****************************************************************************/
+
+#include "NpyFile.hpp"
+
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace pdal
+{
+
+namespace
+{
+
+// Far larger than any numpy type, so sums of field sizes can't overflow.
+const size_t MaxTypeSize = (size_t)1 << 30;
+
+// The subset of Python literal syntax that numpy writes in .npy headers:
+// a dict of strings, integers, booleans, tuples and lists.
+struct Literal
+{
+    enum class Kind
+    {
+        String,
+        Integer,
+        Boolean,
+        Sequence,
+        Dict
+    };
+
+    Kind m_kind;
+    std::string m_string;
+    uint64_t m_integer;
+    bool m_boolean;
+    std::vector<Literal> m_items;
+    std::vector<std::pair<std::string, Literal>> m_entries;
+
+    const Literal *find(const std::string& key) const
+    {
+        for (auto& e : m_entries)
+            if (e.first == key)
+                return &e.second;
+        return nullptr;
+    }
+};
+
+
+class LiteralParser
+{
+public:
+    LiteralParser(const std::string& text) : m_text(text), m_pos(0)
+    {}
+
+    Literal parse()
+    {
+        Literal l = value();
+        skipSpace();
+        if (m_pos != m_text.size())
+            error();
+        return l;
+    }
+
+private:
+    [[noreturn]] void error()
+    {
+        throw pdal_error("Unable to parse .npy header at position " +
+            std::to_string(m_pos) + ".");
+    }
+
+    void skipSpace()
+    {
+        while (m_pos < m_text.size() && std::isspace((unsigned char)m_text[m_pos]))
+            m_pos++;
+    }
+
+    char peek()
+    {
+        skipSpace();
+        return m_pos < m_text.size() ? m_text[m_pos] : '\0';
+    }
+
+    void expect(char c)
+    {
+        if (peek() != c)
+            error();
+        m_pos++;
+    }
+
+    bool keyword(const char *word)
+    {
+        size_t len = std::strlen(word);
+        if (m_text.compare(m_pos, len, word) != 0)
+            return false;
+        m_pos += len;
+        return true;
+    }
+
+    Literal value()
+    {
+        Literal l;
+        char c = peek();
+        if (c == '\'' || c == '"')
+        {
+            l.m_kind = Literal::Kind::String;
+            l.m_string = string();
+        }
+        else if (std::isdigit((unsigned char)c))
+        {
+            l.m_kind = Literal::Kind::Integer;
+            l.m_integer = 0;
+            while (m_pos < m_text.size() &&
+                std::isdigit((unsigned char)m_text[m_pos]))
+            {
+                const uint64_t digit = m_text[m_pos] - '0';
+                if (l.m_integer > (UINT64_MAX - digit) / 10)
+                    error();
+                l.m_integer = l.m_integer * 10 + digit;
+                m_pos++;
+            }
+            // Python 2 long suffix, in old files.
+            if (m_pos < m_text.size() && m_text[m_pos] == 'L')
+                m_pos++;
+        }
+        else if (c == '(' || c == '[')
+        {
+            l.m_kind = Literal::Kind::Sequence;
+            const char close = (c == '(') ? ')' : ']';
+            m_pos++;
+            while (peek() != close)
+            {
+                l.m_items.push_back(value());
+                if (peek() != ',')
+                    break;
+                m_pos++;
+            }
+            expect(close);
+        }
+        else if (c == '{')
+        {
+            l.m_kind = Literal::Kind::Dict;
+            m_pos++;
+            while (peek() != '}')
+            {
+                if (peek() != '\'' && peek() != '"')
+                    error();
+                std::string key = string();
+                expect(':');
+                l.m_entries.push_back(std::make_pair(key, value()));
+                if (peek() != ',')
+                    break;
+                m_pos++;
+            }
+            expect('}');
+        }
+        else if (keyword("True"))
+        {
+            l.m_kind = Literal::Kind::Boolean;
+            l.m_boolean = true;
+        }
+        else if (keyword("False"))
+        {
+            l.m_kind = Literal::Kind::Boolean;
+            l.m_boolean = false;
+        }
+        else
+            error();
+        return l;
+    }
+
+    // Field names and type strings don't use escapes, so a string with
+    // one isn't handled.
+    std::string string()
+    {
+        const char quote = m_text[m_pos++];
+        size_t end = m_text.find(quote, m_pos);
+        if (end == std::string::npos)
+            error();
+        std::string s = m_text.substr(m_pos, end - m_pos);
+        if (s.find('\\') != std::string::npos)
+            error();
+        m_pos = end + 1;
+        return s;
+    }
+
+    const std::string& m_text;
+    size_t m_pos;
+};
+
+
+// Parses a type string such as '<f8'.
+NpyFile::Field parseType(const std::string& name, const Literal& type)
+{
+    if (type.m_kind != Literal::Kind::String)
+        throw pdal_error("Field '" + name + "' of .npy file has a nested "
+            "type.");
+
+    const std::string& s = type.m_string;
+    NpyFile::Field f { name, '|', '\0', 0, 0 };
+    size_t pos = 0;
+    if (pos < s.size() && std::strchr("<>=|", s[pos]))
+        f.m_byteorder = s[pos++];
+    if (pos < s.size())
+        f.m_kind = s[pos++];
+    size_t digits = pos;
+    while (pos < s.size() && std::isdigit((unsigned char)s[pos]) &&
+            f.m_size <= MaxTypeSize)
+        f.m_size = f.m_size * 10 + (s[pos++] - '0');
+    if (pos != s.size() || digits == pos || !f.m_size ||
+            f.m_size > MaxTypeSize)
+        throw pdal_error("Unsupported type '" + s + "' in .npy file.");
+    return f;
+}
+
+} // unnamed namespace
+
+
+#ifdef _WIN32
+
+NpyFile::NpyFile(const std::string& filename) : m_filename(filename),
+    m_map(nullptr), m_mapSize(0), m_data(nullptr)
+{
+    throw pdal_error("Mapping .npy files isn't supported on this platform.");
+}
+
+
+NpyFile::~NpyFile()
+{}
+
+#else
+
+NpyFile::NpyFile(const std::string& filename) : m_filename(filename),
+    m_structured(false), m_fortranOrder(false), m_itemSize(0), m_count(0),
+    m_map(nullptr), m_mapSize(0), m_data(nullptr)
+{
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw pdal_error("Unable to open '" + filename + "'.");
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        ::close(fd);
+        throw pdal_error("Unable to read '" + filename + "'.");
+    }
+    m_mapSize = (size_t)st.st_size;
+    m_map = mmap(nullptr, m_mapSize, PROT_READ, MAP_SHARED, fd, 0);
+    // The mapping holds its own reference to the file.
+    ::close(fd);
+    if (m_map == MAP_FAILED)
+    {
+        m_map = nullptr;
+        throw pdal_error("Unable to map '" + filename + "'.");
+    }
+
+    try
+    {
+        // Magic string, version and header length.
+        const unsigned char *p = (const unsigned char *)m_map;
+        const size_t prefix = 10;
+        if (m_mapSize < prefix || std::memcmp(p, "\x93NUMPY", 6) != 0)
+            throw pdal_error("'" + filename + "' isn't a .npy file.");
+        const int major = p[6];
+        size_t headerLen;
+        size_t start;
+        if (major == 1)
+        {
+            headerLen = p[8] | (p[9] << 8);
+            start = prefix;
+        }
+        else if (major == 2 || major == 3)
+        {
+            if (m_mapSize < 12)
+                throw pdal_error("'" + filename + "' is truncated.");
+            headerLen = p[8] | (p[9] << 8) | (p[10] << 16) |
+                ((size_t)p[11] << 24);
+            start = 12;
+        }
+        else
+            throw pdal_error("Unsupported .npy version " +
+                std::to_string(major) + " in '" + filename + "'.");
+        if (m_mapSize < start + headerLen)
+            throw pdal_error("'" + filename + "' is truncated.");
+
+        parseHeader(std::string((const char *)p + start, headerLen));
+
+        const size_t offset = start + headerLen;
+        if ((m_mapSize - offset) / m_itemSize < m_count)
+            throw pdal_error("'" + filename + "' is truncated.");
+        m_data = (const char *)m_map + offset;
+
+#ifdef MADV_SEQUENTIAL
+        // Only a hint, for the kernel's read-ahead.
+        (void)madvise(m_map, m_mapSize, MADV_SEQUENTIAL);
+#endif
+    }
+    catch (...)
+    {
+        munmap(m_map, m_mapSize);
+        throw;
+    }
+}
+
+
+NpyFile::~NpyFile()
+{
+    if (m_map)
+        munmap(m_map, m_mapSize);
+}
+
+#endif
+
+
+void NpyFile::parseHeader(const std::string& text)
+{
+    Literal header = LiteralParser(text).parse();
+    const Literal *descr = header.find("descr");
+    const Literal *fortran = header.find("fortran_order");
+    const Literal *shape = header.find("shape");
+    if (header.m_kind != Literal::Kind::Dict || !descr || !fortran ||
+        !shape || fortran->m_kind != Literal::Kind::Boolean ||
+        shape->m_kind != Literal::Kind::Sequence)
+        throw pdal_error("Invalid header in .npy file '" + m_filename + "'.");
+
+    m_fortranOrder = fortran->m_boolean;
+
+    // The shape's product must fit, so that a crafted header can't wrap
+    // the count to something the file appears to hold.
+    uint64_t count = 1;
+    for (const Literal& dim : shape->m_items)
+    {
+        if (dim.m_kind != Literal::Kind::Integer)
+            throw pdal_error("Invalid shape in .npy file '" +
+                m_filename + "'.");
+        // Dimensions are numpy's signed size type when they're read.
+        if (dim.m_integer > (uint64_t)PTRDIFF_MAX ||
+                (dim.m_integer && count > SIZE_MAX / dim.m_integer))
+            throw pdal_error("Shape of .npy file '" + m_filename +
+                "' is too large.");
+        m_shape.push_back((size_t)dim.m_integer);
+        count *= dim.m_integer;
+    }
+    m_count = (point_count_t)count;
+
+    // A list of (name, type) pairs for a structured array.  Unnamed void
+    // fields are padding.
+    if (descr->m_kind == Literal::Kind::Sequence)
+    {
+        m_structured = true;
+        for (const Literal& item : descr->m_items)
+        {
+            if (item.m_kind != Literal::Kind::Sequence ||
+                item.m_items.size() != 2 ||
+                item.m_items[0].m_kind != Literal::Kind::String)
+                throw pdal_error("Unsupported field in .npy file '" +
+                    m_filename + "'.");
+            const std::string& name = item.m_items[0].m_string;
+            Field f = parseType(name, item.m_items[1]);
+            f.m_offset = m_itemSize;
+            if (f.m_size > MaxTypeSize - m_itemSize)
+                throw pdal_error("Type of .npy file '" + m_filename +
+                    "' is too large.");
+            m_itemSize += f.m_size;
+            if (name.size() || f.m_kind != 'V')
+                m_fields.push_back(f);
+        }
+    }
+    else
+    {
+        Field f = parseType("", *descr);
+        m_itemSize = f.m_size;
+        m_fields.push_back(f);
+    }
+    if (!m_itemSize)
+        throw pdal_error("Invalid type in .npy file '" + m_filename + "'.");
+    if (m_count > SIZE_MAX / m_itemSize)
+        throw pdal_error("Data of .npy file '" + m_filename + "' is too "
+            "large.");
+}
+
+} // namespace pdal
@@ -0,0 +1,101 @@
+/******************************************************************************
+* Copyright (c) 2026, Hobu Inc. (info@hobu.co)
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following
+* conditions are met:
+*
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in
+*       the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of Hobu, Inc. or Flaxen Geo Consulting nor the
+*       names of its contributors may be used to endorse or promote
+*       products derived from this software without specific prior
+*       written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+* COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+* OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+* AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+* OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+* OF SUCH DAMAGE.
+****************************************************************************/
+
+#pragma once
+
+#include <pdal/pdal_internal.hpp>
+
+#include <string>
+#include <vector>
+
+namespace pdal
+{
+
+// A .npy file mapped into memory.  The header is parsed here and the
+// array data is read straight from the mapping, so opening a file costs
+// the same whatever its size and the pages are shared by every process
+// reading it.  Throws pdal_error if the file can't be read this way:
+// it's malformed, or it holds something other than a plain array of
+// numbers or a flat structured array of them.
+class NpyFile
+{
+public:
+    // A field of each array element.  An unstructured array has a single
+    // field with an empty name.
+    struct Field
+    {
+        std::string m_name;
+        char m_byteorder;   // '<', '>', '=' or '|', as in numpy.
+        char m_kind;        // 'i', 'u', 'f', ... as in numpy.
+        size_t m_size;
+        size_t m_offset;
+    };
+
+    NpyFile(const std::string& filename);
+    ~NpyFile();
+
+    NpyFile(const NpyFile&) = delete;
+    NpyFile& operator=(const NpyFile&) = delete;
+
+    bool structured() const
+        { return m_structured; }
+    const std::vector<Field>& fields() const
+        { return m_fields; }
+    const std::vector<size_t>& shape() const
+        { return m_shape; }
+    bool fortranOrder() const
+        { return m_fortranOrder; }
+    size_t itemSize() const
+        { return m_itemSize; }
+    point_count_t count() const
+        { return m_count; }
+    const char *data() const
+        { return m_data; }
+
+private:
+    void parseHeader(const std::string& header);
+
+    std::string m_filename;
+    bool m_structured;
+    std::vector<Field> m_fields;
+    std::vector<size_t> m_shape;
+    bool m_fortranOrder;
+    size_t m_itemSize;
+    point_count_t m_count;
+    void *m_map;
+    size_t m_mapSize;
+    const char *m_data;
+};
+
+} // namespace pdal
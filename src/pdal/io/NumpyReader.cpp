@@ -41,7 +41,9 @@
 #include <pdal/util/ProgramArgs.hpp>
 #include <pdal/util/FileUtils.hpp>
 #include <pdal/util/Algorithm.hpp>
-#include <pdal/util/Extractor.hpp>
+
+#include <algorithm>
+#include <functional>
 
 
 
@@ -70,6 +72,14 @@ std::string toString(PyObject *pname)
 namespace pdal
 {
 
+namespace
+{
+
+// Fewer points than this aren't worth giving to another thread.
+const point_count_t MinSlicePoints = 65536;
+
+} // unnamed namespace
+
 static PluginInfo const s_info
 {
     "readers.numpy",
@@ -83,6 +93,9 @@ struct NumpyReader::Args
     std::string function;
     std::string source;
     std::string fargs;
+    std::string cacheDir;
+    point_count_t start;
+    size_t threads;
 };
 
 CREATE_SHARED_STAGE(NumpyReader, s_info)
@@ -178,12 +191,13 @@ PyArrayObject* load_npy_file(std::string const& filename)
 PyArrayObject* load_npy_script(std::string const& source,
                                std::string const& module,
                                std::string const& function,
-                               std::string const& fargs)
+                               std::string const& fargs,
+                               std::string const& cacheDir)
 {
 
     MetadataNode m;
     plang::Script script(source, module, function);
-    plang::Invocation method(script, m, fargs);
+    plang::Invocation method(script, m, fargs, cacheDir);
 
     StringList args = Utils::split(fargs,',');
 
@@ -212,7 +226,6 @@ PyArrayObject* load_npy_script(std::string const& source,
 void NumpyReader::initialize()
 {
     plang::Environment::get();
-    plang::gil_scoped_acquire acquire;
     m_numPoints = 0;
     m_chunkCount = 0;
     m_ndims = 0;
@@ -224,9 +237,11 @@ void NumpyReader::initialize()
     m_strideptr = NULL;
     m_innersizeptr = NULL;
     m_dtype = NULL;
+    m_file.reset();
 
     if (m_args->function.size() )
     {
+        plang::gil_scoped_acquire acquire;
         // Invoke the script and use the returned
         // numpy array
         //
@@ -234,7 +249,8 @@ void NumpyReader::initialize()
         m_array = load_npy_script(m_args->source,
                                   m_args->module,
                                   m_args->function,
-                                  m_args->fargs);
+                                  m_args->fargs,
+                                  m_args->cacheDir);
         if (!PyArray_Check(m_array))
         {
             std::stringstream errMsg;
@@ -247,6 +263,20 @@ void NumpyReader::initialize()
     }
     else if (m_filename.size())
     {
+        // Arrays of plain numbers are mapped and read without Python.
+        // Anything else is left to numpy.
+        try
+        {
+            m_file.reset(new NpyFile(m_filename));
+            return;
+        }
+        catch (const pdal_error& err)
+        {
+            log()->get(LogLevel::Debug) << "Loading '" << m_filename <<
+                "' with numpy: " << err.what() << std::endl;
+        }
+
+        plang::gil_scoped_acquire acquire;
         m_array = load_npy_file(m_filename);
         if (!PyArray_Check(m_array))
             throw pdal::pdal_error("Object in file  '" + m_filename +
@@ -256,10 +286,53 @@ void NumpyReader::initialize()
 }
 
 
+// Only the header of a mapped file is read, so the point count is cheap
+// to get before reading.
+QuickInfo NumpyReader::inspect()
+{
+    QuickInfo qi;
+    std::unique_ptr<PointLayout> layout(new PointLayout());
+
+    // done() releases the array, but one handed to setArray() is still
+    // needed for the read.
+    PyArrayObject *array = m_array;
+    {
+        plang::gil_scoped_acquire acquire;
+        Py_XINCREF(array);
+    }
+
+    initialize();
+    addDimensions(layout.get());
+
+    for (Dimension::Id id : layout->dims())
+        qi.m_dimNames.push_back(layout->dimName(id));
+    qi.m_pointCount = m_end - m_start;
+    qi.m_valid = true;
+
+    PointTable table;
+    done(table);
+    m_array = array;
+    return qi;
+}
+
+
 void NumpyReader::wakeUpNumpyArray()
 {
     // TODO pivot whether we are a 1d, 2d, or named arrays
 
+    if (m_file)
+    {
+        if (m_file->count() == 0)
+            throw pdal::pdal_error("Array cannot be empty!");
+        m_fileShape.assign(m_file->shape().begin(), m_file->shape().end());
+        m_ndims = (int)m_fileShape.size();
+        m_shape = m_fileShape.data();
+        m_numPoints = m_file->count();
+        if (!m_orderArg->set())
+            m_order = m_file->fortranOrder() ? Order::Column : Order::Row;
+        return;
+    }
+
     if (PyArray_SIZE(m_array) == 0)
         throw pdal::pdal_error("Array cannot be empty!");
 
@@ -327,6 +400,14 @@ void NumpyReader::addArgs(ProgramArgs& args)
     args.add("function", "Function nameto call",
         m_args->function);
     args.add("fargs", "Args to call function with ", m_args->fargs);
+    args.add("bytecode_cache", "Directory in which the compiled script is "
+        "cached, so that later runs skip compiling it", m_args->cacheDir);
+    args.add("start", "Position of the first array element read.  "
+        "Elements are numbered in the order they're stored.  With 'count', "
+        "lets several readers each read a part of one array.",
+        m_args->start, (point_count_t)0);
+    args.add("threads", "Number of threads used to copy array elements "
+        "into the point view", m_args->threads, (size_t)1);
 
 }
 
@@ -361,6 +442,39 @@ Dimension::Id NumpyReader::registerDim(PointLayoutPtr layout,
 }
 
 
+// The PDAL type of a field of a mapped file, or None if there isn't one.
+Dimension::Type fileFieldType(const NpyFile::Field& f)
+{
+    using namespace Dimension;
+
+    if (f.m_kind == 'f')
+    {
+        if (f.m_size == 4)
+            return Type::Float;
+        if (f.m_size == 8)
+            return Type::Double;
+        return Type::None;
+    }
+    if (f.m_kind != 'i' && f.m_kind != 'u')
+        return Type::None;
+
+    const bool sign = (f.m_kind == 'i');
+    switch (f.m_size)
+    {
+    case 1:
+        return sign ? Type::Signed8 : Type::Unsigned8;
+    case 2:
+        return sign ? Type::Signed16 : Type::Unsigned16;
+    case 4:
+        return sign ? Type::Signed32 : Type::Unsigned32;
+    case 8:
+        return sign ? Type::Signed64 : Type::Unsigned64;
+    default:
+        return Type::None;
+    }
+}
+
+
 void NumpyReader::createFields(PointLayoutPtr layout)
 {
 
@@ -382,9 +496,34 @@ void NumpyReader::createFields(PointLayoutPtr layout)
     Dimension::Type type;
     int offset;
 
+    m_fields.clear();
+    if (m_file)
+    {
+        m_numFields = (int)m_file->fields().size();
+        for (const NpyFile::Field& f : m_file->fields())
+        {
+            const std::string& name =
+                m_file->structured() ? f.m_name : m_defaultDimension;
+            type = fileFieldType(f);
+            if (type == Dimension::Type::None)
+            {
+                std::ostringstream oss;
+                oss << "Unable to map dimension '" << name << "' because "
+                    "its type '" << f.m_kind << f.m_size << "' is not "
+                    "mappable to PDAL";
+                throw pdal_error(oss.str());
+            }
+            id = registerDim(layout, name, type);
+            m_fields.push_back({id, type, (int)f.m_offset,
+                !PyArray_ISNBO(f.m_byteorder)});
+        }
+        return;
+    }
+
     m_numFields = 0;
     PyObject* fields = PyDataType_FIELDS(m_dtype);
-    if (fields != Py_None)
+    // Numpy 2 has no fields dictionary for unstructured types.
+    if (fields && fields != Py_None)
         m_numFields = static_cast<int>(PyDict_Size(fields));
 
     // Array isn't structured - just a bunch of data.
@@ -392,7 +531,7 @@ void NumpyReader::createFields(PointLayoutPtr layout)
     {
         type = getPDALType(m_dtype->type_num, m_defaultDimension);
         id = registerDim(layout, m_defaultDimension, type);
-        m_fields.push_back({id, type, 0});
+        m_fields.push_back({id, type, 0, !PyArray_ISNBO(m_dtype->byteorder)});
     }
     else
     {
@@ -419,10 +558,9 @@ void NumpyReader::createFields(PointLayoutPtr layout)
             PyArray_Descr* dt = (PyArray_Descr *)PySequence_Fast_GET_ITEM(tup, 0);
             type = getPDALType(dt->type_num, name);
 
-            char byteorder = dt->byteorder;
-            int elsize = (int) PyDataType_ELSIZE(dt);
             id = registerDim(layout, name, type);
-            m_fields.push_back({id, type, offset, byteorder, elsize});
+            m_fields.push_back({id, type, offset,
+                !PyArray_ISNBO(dt->byteorder)});
         }
     }
 }
@@ -436,6 +574,9 @@ void NumpyReader::addDimensions(PointLayoutPtr layout)
     wakeUpNumpyArray();
     createFields(layout);
 
+    m_start = (std::min)(m_args->start, m_numPoints);
+    m_end = m_start + (std::min)(m_count, m_numPoints - m_start);
+
     m_storeXYZ = true;
     // If we already have an X dimension, we're done.
     for (const Field& field : m_fields)
@@ -497,26 +638,48 @@ void NumpyReader::ready(PointTableRef table)
     plang::gil_scoped_acquire acquire;
     plang::Environment::get()->set_stdout(log()->getLogStream());
 
-    // Set our iterators
-    // The location of the data pointer which the iterator may update
-    m_dataptr = NpyIter_GetDataPtrArray(m_iter);
+    // A mapped file is read as a single chunk.
+    if (m_file)
+    {
+        p_data = const_cast<char *>(m_file->data());
+        m_stride = (npy_intp)m_file->itemSize();
+        m_chunkCount = (npy_intp)m_numPoints;
+    }
+    else
+    {
+        // Set our iterators
+        // The location of the data pointer which the iterator may update
+        m_dataptr = NpyIter_GetDataPtrArray(m_iter);
 
-    // The location of the stride which the iterator may update
-    m_strideptr = NpyIter_GetInnerStrideArray(m_iter);
+        // The location of the stride which the iterator may update
+        m_strideptr = NpyIter_GetInnerStrideArray(m_iter);
 
-    // The location of the inner loop size which the iterator may update
-    m_innersizeptr = NpyIter_GetInnerLoopSizePtr(m_iter);
+        // The location of the inner loop size which the iterator may update
+        m_innersizeptr = NpyIter_GetInnerLoopSizePtr(m_iter);
 
-    p_data = *m_dataptr;
-    m_chunkCount = *m_innersizeptr;
-    m_index = 0;
+        p_data = *m_dataptr;
+        m_stride = *m_strideptr;
+        m_chunkCount = *m_innersizeptr;
+    }
+
+    // Skip to the first element read.  Whole chunks are skipped at a
+    // time, so this costs nothing for a mapped file or a contiguous array.
+    // If nothing is to be read, there's nothing to skip.
+    m_index = (m_start == m_end) ? m_end : 0;
+    while (m_index < m_start)
+    {
+        const npy_intp count = (npy_intp)(std::min)(
+            (point_count_t)m_chunkCount, m_start - m_index);
+        advance(count);
+        m_index += count;
+    }
 
     log()->get(LogLevel::Debug) << "Initializing Numpy array for file '" <<
         m_filename << "'" << std::endl;
     log()->get(LogLevel::Debug) << "numpy inner stride '" <<
-        *m_strideptr << "'" << std::endl;
+        m_stride << "'" << std::endl;
     log()->get(LogLevel::Debug) << "numpy inner stride size '" <<
-        *m_innersizeptr << "'" << std::endl;
+        m_chunkCount << "'" << std::endl;
     log()->get(LogLevel::Debug) << "numpy number of points '" <<
         m_numPoints << "'" << std::endl;
     log()->get(LogLevel::Debug) << "numpy number of dimensions '" <<
@@ -525,6 +688,9 @@ void NumpyReader::ready(PointTableRef table)
         log()->get(LogLevel::Debug) << "numpy shape dimension number '" <<
             i << "' is '" << m_shape[i] <<"'" << std::endl;
 
+    if (m_args->threads > 1)
+        m_workers.reset(new ThreadPool(m_args->threads));
+
     PointLayoutPtr layout = table.layout();
     MetadataNode m = layout->toMetadata();
 
@@ -532,12 +698,17 @@ void NumpyReader::ready(PointTableRef table)
 
 }
 
-bool NumpyReader::nextPoint()
+// Moves 'count' points along the iterator's current chunk, which must have
+// that many left, and fetches the next chunk when this one is used up.
+// Returns false at the end of the array.
+bool NumpyReader::advance(npy_intp count)
 {
-    // If we are at the end of this chunk, try to fetch another.  Otherwise,
-    // just advance by the stride.
-    if (--m_chunkCount == 0)
+    m_chunkCount -= count;
+    if (m_chunkCount == 0)
     {
+        if (!m_iter)
+            return false;
+
         // Go grab the gil before we touch Python stuff again
         plang::gil_scoped_acquire acquire;
         // If we can't fetch the next ite
@@ -545,99 +716,26 @@ bool NumpyReader::nextPoint()
             return false;
         m_chunkCount = *m_innersizeptr;
         p_data = *m_dataptr;
+        m_stride = *m_strideptr;
     }
     else
-        p_data += *m_strideptr;
+        p_data += count * m_stride;
     return true;
 }
 
 
-
-
-bool NumpyReader::loadPoint(PointRef& point, point_count_t position)
+void NumpyReader::loadPoint(PointRef& point, point_count_t position)
 {
-    using namespace Dimension;
-
-    pdal::SwitchableExtractor extractor(p_data, *m_strideptr);
-
-    std::vector<char> buf(*m_strideptr,0);
-
-    float flt(0.0);
-    double dbl(0.0);
-    uint8_t u8(0);
-    uint16_t u16(0);
-    uint32_t u32(0);
-    uint64_t u64(0);
-    int8_t i8(0);
-    int16_t i16(0);
-    int32_t i32(0);
-    int64_t i64(0);
-
+    char buf[8];
     for (const Field& f : m_fields)
     {
-        if (f.m_byteorder == '>')
-            extractor.switchToBigEndian();
-        else
-            extractor.switchToLittleEndian();
-
-        switch (f.m_type)
+        const char *value = p_data + f.m_offset;
+        if (f.m_swap)
         {
-            case Dimension::Type::Signed8:
-                extractor >> i8;
-                point.setField(f.m_id, i8);
-                break;
-
-            case Dimension::Type::Signed16:
-                extractor >> i16;
-                point.setField(f.m_id, i16);
-                break;
-
-            case Dimension::Type::Signed32:
-                extractor >> i32;
-                point.setField(f.m_id, i32);
-                break;
-
-            case Dimension::Type::Signed64:
-                extractor >> i64;
-                point.setField(f.m_id, i64);
-                break;
-
-            case Dimension::Type::Unsigned8:
-                extractor >> u8;
-                point.setField(f.m_id, u8);
-                break;
-
-            case Dimension::Type::Unsigned16:
-                extractor >> u16;
-                point.setField(f.m_id, u16);
-                break;
-
-            case Dimension::Type::Unsigned32:
-                extractor >> u32;
-                point.setField(f.m_id, u32);
-                break;
-
-            case Dimension::Type::Unsigned64:
-                extractor >> u64;
-                point.setField(f.m_id, u64);
-                break;
-
-            case Dimension::Type::Float:
-                extractor >> flt;
-                point.setField(f.m_id, flt);
-                break;
-
-            case Dimension::Type::Double:
-                extractor >> dbl;
-                point.setField(f.m_id, dbl);
-                break;
-
-            default:
-                // skip it
-                extractor.skip(f.m_elsize);
-
+            std::reverse_copy(value, value + Dimension::size(f.m_type), buf);
+            value = buf;
         }
-
+        point.setField(f.m_id, f.m_type, value);
     }
 
     if (m_storeXYZ)
@@ -650,32 +748,134 @@ bool NumpyReader::loadPoint(PointRef& point, point_count_t position)
                 point.setField(Dimension::Id::Z, (position % m_zIter) / m_zDiv);
         }
     }
-
-    return (nextPoint());
 }
 
 
 bool NumpyReader::processOne(PointRef& point)
 {
-    if (m_index >= m_numPoints)
+    if (m_index >= m_end)
         return false;
-    return loadPoint(point, m_index++);
+    loadPoint(point, m_index++);
+    advance(1);
+    return true;
 }
 
 
+// Copies 'count' values of 'type', 'stride' bytes apart at 'src', into
+// dimension 'id' of the points of the view from 'begin'.
+void NumpyReader::copyField(PointView& view, const plang::PointRunList& runs,
+    PointId begin, point_count_t count, Dimension::Id id,
+    Dimension::Type type, const char *src, npy_intp stride, bool swap)
+{
+    PointLayoutPtr layout(view.layout());
+    const Dimension::Detail *detail = layout->dimDetail(id);
+    const size_t size = Dimension::size(type);
+
+    // Values go straight into table memory unless they need converting.
+    if (runs.size() && detail->type() == type)
+    {
+        plang::scatterDim(runs, layout->pointSize(), detail->offset(), size,
+            src, stride, count, swap);
+        return;
+    }
+
+    char buf[8];
+    for (PointId idx = begin; idx < begin + count; ++idx)
+    {
+        const char *value = src;
+        if (swap)
+        {
+            std::reverse_copy(src, src + size, buf);
+            value = buf;
+        }
+        view.setField(id, type, idx, value);
+        src += stride;
+    }
+}
+
+
+// Copies 'count' array elements from 'data', the first of which is at
+// 'position' in the array, into the points of the view from 'begin'.
+// 'runs' holds just those points.  Doesn't touch Python objects.
+void NumpyReader::copyPoints(PointView& view, const plang::PointRunList& runs,
+    PointId begin, point_count_t count, point_count_t position,
+    const char *data)
+{
+    for (const Field& f : m_fields)
+        copyField(view, runs, begin, count, f.m_id, f.m_type,
+            data + f.m_offset, m_stride, f.m_swap);
+
+    if (m_storeXYZ)
+    {
+        std::vector<int32_t> coords(count);
+        auto storeCoords = [&](Dimension::Id id, size_t iter, size_t div)
+        {
+            for (point_count_t i = 0; i < count; ++i)
+                coords[i] = (int32_t)(((position + i) % iter) / div);
+            copyField(view, runs, begin, count, id,
+                Dimension::Type::Signed32, (const char *)coords.data(),
+                sizeof(int32_t), false);
+        };
+        storeCoords(Dimension::Id::X, m_xIter, m_xDiv);
+        if (m_ndims > 1)
+        {
+            storeCoords(Dimension::Id::Y, m_yIter, m_yDiv);
+            if (m_ndims > 2)
+                storeCoords(Dimension::Id::Z, m_zIter, m_zDiv);
+        }
+    }
+}
+
+
+// Points are copied a chunk of the iterator at a time and a field at a
+// time, without the GIL.  It's only taken in advance() to fetch the next
+// chunk, so other threads' Python work isn't held up.  With 'threads',
+// a chunk is split into slices that are copied at once.  A mapped file
+// is a single chunk.
 point_count_t NumpyReader::read(PointViewPtr view, point_count_t numToRead)
 {
-    plang::gil_scoped_acquire acquire;
-    PointId idx = view->size();
     point_count_t numRead(0);
 
-    while (numRead < numToRead)
+    while (numRead < numToRead && m_index < m_end)
     {
-        PointRef point(*view, idx);
-        if (!processOne(point))
+        const point_count_t count = (std::min)((std::min)(
+            (point_count_t)m_chunkCount, numToRead - numRead),
+            m_end - m_index);
+
+        // Adding the points first lets the fields be copied over runs of
+        // points in table memory.
+        const PointId begin = view->size();
+        plang::appendPoints(*view, count);
+        plang::PointRunList runs =
+            plang::findRuns(*view, begin, begin + count);
+
+        // Slices are only made over table memory, where each thread
+        // writes its own points.
+        if (m_workers && runs.size())
+        {
+            plang::RunSliceList slices = plang::splitRuns(runs,
+                view->layout()->pointSize(), m_args->threads,
+                MinSlicePoints);
+            std::vector<std::function<void()>> tasks;
+            for (const plang::RunSlice& s : slices)
+            {
+                const plang::RunSlice *slice = &s;
+                tasks.push_back([=]()
+                {
+                    copyPoints(*view, slice->m_runs, begin + slice->m_start,
+                        slice->m_count, m_index + slice->m_start,
+                        p_data + slice->m_start * m_stride);
+                });
+            }
+            plang::runTasks(m_workers.get(), tasks);
+        }
+        else
+            copyPoints(*view, runs, begin, count, m_index, p_data);
+
+        m_index += count;
+        numRead += count;
+        if (!advance((npy_intp)count))
             break;
-        numRead++;
-        idx++;
     }
     return numRead;
 }
@@ -687,8 +887,12 @@ void NumpyReader::done(PointTableRef)
     // Dereference everything we're using
     if (m_iter)
         NpyIter_Deallocate(m_iter);
+    m_iter = nullptr;
 
     Py_XDECREF(m_array);
+    m_array = nullptr;
+    m_file.reset();
+    m_workers.reset();
 }
 
 
@@ -39,10 +39,13 @@
 
 #include "../plang/Environment.hpp"
 #include "../plang/Invocation.hpp"
+#include "NpyFile.hpp"
 
 #define NO_IMPORT_ARRAY // Already have it from Environment.hpp
 #include <numpy/ndarrayobject.h>
 
+#include <pdal/util/ThreadPool.hpp>
+
 #include <memory>
 
 namespace pdal
@@ -70,6 +73,7 @@ public:
 
 private:
     virtual void initialize();
+    virtual QuickInfo inspect();
     virtual void addArgs(ProgramArgs& args);
     virtual void addDimensions(PointLayoutPtr layout);
     virtual void ready(PointTableRef table);
@@ -78,8 +82,14 @@ private:
     virtual void done(PointTableRef table);
 
     void createFields(PointLayoutPtr layout);
-    bool nextPoint();
-    bool loadPoint(PointRef& point, point_count_t position);
+    bool advance(npy_intp count);
+    void loadPoint(PointRef& point, point_count_t position);
+    void copyPoints(PointView& view, const plang::PointRunList& runs,
+        PointId begin, point_count_t count, point_count_t position,
+        const char *data);
+    void copyField(PointView& view, const plang::PointRunList& runs,
+        PointId begin, point_count_t count, Dimension::Id id,
+        Dimension::Type type, const char *src, npy_intp stride, bool swap);
     void wakeUpNumpyArray();
     Dimension::Id registerDim(PointLayoutPtr layout, const std::string& name,
         Dimension::Type pdalType);
@@ -92,8 +102,13 @@ private:
     NpyIter_IterNextFunc* m_iternext;
     PyArray_Descr* m_dtype;
 
+    // Set instead of the array and iterator when a file is read directly.
+    std::unique_ptr<NpyFile> m_file;
+    std::vector<npy_intp> m_fileShape;
+
     char** m_dataptr;
     char* p_data;
+    npy_intp m_stride;
     npy_intp m_nonzero_count;
     npy_intp* m_strideptr, *m_innersizeptr;
     npy_intp* m_shape;
@@ -113,16 +128,23 @@ private:
     size_t m_yDiv;
     size_t m_zDiv;
 
+    // How to decode a field of each array element.  Built once in
+    // createFields().
     struct Field
     {
         Dimension::Id m_id;
         Dimension::Type m_type;
         int m_offset;
-        char m_byteorder;
-        int m_elsize;
+        bool m_swap;    // Stored in the opposite byte order to ours.
     };
     std::vector<Field> m_fields;
+    // Position of the next element read, and the range of positions read.
     point_count_t m_index;
+    point_count_t m_start;
+    point_count_t m_end;
+
+    // Threads that copy a chunk's points when 'threads' is above one.
+    std::unique_ptr<ThreadPool> m_workers;
 
     struct Args;
     std::unique_ptr<Args> m_args;
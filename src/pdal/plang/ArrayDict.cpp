@@ -0,0 +1,601 @@
+/******************************************************************************
+* Copyright (c) 2026, Hobu Inc. (info@hobu.co)
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following
+* conditions are met:
+*
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in
+*       the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of Hobu, Inc. or Flaxen Geo Consulting nor the
+*       names of its contributors may be used to endorse or promote
+*       products derived from this software without specific prior
+*       written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+* COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+* OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+* AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+* OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+* OF SUCH DAMAGE.
+****************************************************************************/
+
+#include "ArrayDict.hpp"
+#include "gil.hpp"
+
+#include <exception>
+#include <mutex>
+
+namespace pdal
+{
+namespace plang
+{
+
+namespace
+{
+
+// A dict subclass, so that scripts and the code they call (json, pandas,
+// isinstance(ins, dict)) treat it as the plain dict they used to get.
+// Until it's expanded, the dict holds only the arrays that have been
+// built, and 'keys' holds every name in layout order.  Anything that
+// needs the whole dict expands it first, after which it's a plain dict.
+struct ArrayDict
+{
+    PyDictObject dict;
+    PyObject *keys;         // List of names.  Null once expanded.
+    ArrayLoader *loader;    // Null once detached.
+};
+
+PyTypeObject ArrayDictType;
+PyObject *keysViewType;     // collections.abc.KeysView
+
+
+// Returns 1 if the dictionary hasn't been expanded and has 'key'.
+int pending(PyObject *self, PyObject *key)
+{
+    ArrayDict *d = reinterpret_cast<ArrayDict *>(self);
+    if (!d->keys)
+        return 0;
+    int found = PySequence_Contains(d->keys, key);
+    if (found <= 0)
+        return found;
+    found = PyDict_Contains(self, key);
+    return found < 0 ? -1 : !found;
+}
+
+
+// Builds the array 'key' if it hasn't been built.
+// Returns 0 on success, -1 with a Python exception set on failure.
+int build(PyObject *self, PyObject *key)
+{
+    int found = pending(self, key);
+    if (found <= 0)
+        return found;
+
+    ArrayDict *d = reinterpret_cast<ArrayDict *>(self);
+    const char *name = PyUnicode_AsUTF8(key);
+    if (!name)
+        return -1;
+
+    PyObject *array;
+    try
+    {
+        array = (*d->loader)(name);
+    }
+    catch (const std::exception& err)
+    {
+        PyErr_SetString(PyExc_RuntimeError, err.what());
+        return -1;
+    }
+    if (!array)
+        return -1;
+    int result = PyDict_SetItem(self, key, array);
+    Py_DECREF(array);
+    return result;
+}
+
+
+// Turns the dictionary into a plain dict of its arrays, in layout order.
+// Unless the arrays are dropped, the ones that haven't been built are
+// built first.
+// Returns 0 on success, -1 with a Python exception set on failure.
+int expand(PyObject *self, bool drop = false)
+{
+    ArrayDict *d = reinterpret_cast<ArrayDict *>(self);
+    if (!d->keys)
+        return 0;
+
+    PyObject *items = PyList_New(0);
+    if (!items)
+        return -1;
+    for (Py_ssize_t i = 0; i < PyList_GET_SIZE(d->keys); ++i)
+    {
+        PyObject *key = PyList_GET_ITEM(d->keys, i);
+        if (!drop && build(self, key))
+        {
+            Py_DECREF(items);
+            return -1;
+        }
+        PyObject *array = PyDict_GetItemWithError(self, key);
+        PyObject *item = array ? PyTuple_Pack(2, key, array) : nullptr;
+        if (PyErr_Occurred() || (item && PyList_Append(items, item)))
+        {
+            Py_XDECREF(item);
+            Py_DECREF(items);
+            return -1;
+        }
+        Py_XDECREF(item);
+    }
+
+    PyDict_Clear(self);
+    for (Py_ssize_t i = 0; i < PyList_GET_SIZE(items); ++i)
+    {
+        PyObject *item = PyList_GET_ITEM(items, i);
+        if (PyDict_SetItem(self, PyTuple_GET_ITEM(item, 0),
+            PyTuple_GET_ITEM(item, 1)))
+        {
+            Py_DECREF(items);
+            return -1;
+        }
+    }
+    Py_DECREF(items);
+    Py_CLEAR(d->keys);
+    return 0;
+}
+
+
+int ArrayDict_traverse(PyObject *self, visitproc visit, void *arg)
+{
+    Py_VISIT(reinterpret_cast<ArrayDict *>(self)->keys);
+    return PyDict_Type.tp_traverse(self, visit, arg);
+}
+
+
+int ArrayDict_clear(PyObject *self)
+{
+    Py_CLEAR(reinterpret_cast<ArrayDict *>(self)->keys);
+    return PyDict_Type.tp_clear(self);
+}
+
+
+void ArrayDict_dealloc(PyObject *self)
+{
+    ArrayDict *d = reinterpret_cast<ArrayDict *>(self);
+    PyObject_GC_UnTrack(self);
+    Py_CLEAR(d->keys);
+    delete d->loader;
+    d->loader = nullptr;
+    PyDict_Type.tp_dealloc(self);
+}
+
+
+Py_ssize_t ArrayDict_length(PyObject *self)
+{
+    ArrayDict *d = reinterpret_cast<ArrayDict *>(self);
+    if (d->keys)
+        return PyList_GET_SIZE(d->keys);
+    return PyDict_Size(self);
+}
+
+
+// Returns a new reference.
+PyObject *ArrayDict_subscript(PyObject *self, PyObject *key)
+{
+    if (build(self, key))
+        return nullptr;
+
+    PyObject *array = PyDict_GetItemWithError(self, key);
+    if (!array)
+    {
+        if (!PyErr_Occurred())
+            PyErr_SetObject(PyExc_KeyError, key);
+        return nullptr;
+    }
+    Py_INCREF(array);
+    return array;
+}
+
+
+int ArrayDict_ass_subscript(PyObject *self, PyObject *key, PyObject *value)
+{
+    ArrayDict *d = reinterpret_cast<ArrayDict *>(self);
+    if (!d->keys)
+        return PyDict_Type.tp_as_mapping->mp_ass_subscript(self, key, value);
+
+    Py_ssize_t pos = PySequence_Index(d->keys, key);
+    if (pos < 0)
+    {
+        if (!PyErr_ExceptionMatches(PyExc_ValueError))
+            return -1;
+        PyErr_Clear();
+    }
+
+    // Deletion
+    if (!value)
+    {
+        if (pos < 0)
+        {
+            PyErr_SetObject(PyExc_KeyError, key);
+            return -1;
+        }
+        if (PySequence_DelItem(d->keys, pos))
+            return -1;
+        if (PyDict_DelItem(self, key))
+        {
+            if (!PyErr_ExceptionMatches(PyExc_KeyError))
+                return -1;
+            PyErr_Clear();
+        }
+        return 0;
+    }
+
+    if (pos < 0 && PyList_Append(d->keys, key))
+        return -1;
+    return PyDict_SetItem(self, key, value);
+}
+
+
+int ArrayDict_contains(PyObject *self, PyObject *key)
+{
+    ArrayDict *d = reinterpret_cast<ArrayDict *>(self);
+    if (d->keys)
+        return PySequence_Contains(d->keys, key);
+    return PyDict_Contains(self, key);
+}
+
+
+// Iterate over a copy of the names so that the dictionary can be changed
+// during iteration.
+PyObject *ArrayDict_iter(PyObject *self)
+{
+    ArrayDict *d = reinterpret_cast<ArrayDict *>(self);
+    if (!d->keys)
+        return PyDict_Type.tp_iter(self);
+
+    PyObject *keys = PyList_GetSlice(d->keys, 0, PyList_GET_SIZE(d->keys));
+    if (!keys)
+        return nullptr;
+    PyObject *iter = PyObject_GetIter(keys);
+    Py_DECREF(keys);
+    return iter;
+}
+
+
+PyObject *ArrayDict_repr(PyObject *self)
+{
+    if (expand(self))
+        return nullptr;
+    return PyDict_Type.tp_repr(self);
+}
+
+
+PyObject *ArrayDict_richcompare(PyObject *self, PyObject *other, int op)
+{
+    if (expand(self))
+        return nullptr;
+    if (PyObject_TypeCheck(other, &ArrayDictType) && expand(other))
+        return nullptr;
+    return PyDict_Type.tp_richcompare(self, other, op);
+}
+
+
+// Calls the dict method 'name' once the dictionary has been expanded.
+PyObject *callDictMethod(const char *name, PyObject *self, PyObject *args,
+    PyObject *kwargs)
+{
+    if (expand(self))
+        return nullptr;
+
+    PyObject *method = PyObject_GetAttrString(
+        reinterpret_cast<PyObject *>(&PyDict_Type), name);
+    if (!method)
+        return nullptr;
+
+    Py_ssize_t size = args ? PyTuple_GET_SIZE(args) : 0;
+    PyObject *allArgs = PyTuple_New(size + 1);
+    if (!allArgs)
+    {
+        Py_DECREF(method);
+        return nullptr;
+    }
+    Py_INCREF(self);
+    PyTuple_SET_ITEM(allArgs, 0, self);
+    for (Py_ssize_t i = 0; i < size; ++i)
+    {
+        PyObject *arg = PyTuple_GET_ITEM(args, i);
+        Py_INCREF(arg);
+        PyTuple_SET_ITEM(allArgs, i + 1, arg);
+    }
+    PyObject *result = PyObject_Call(method, allArgs, kwargs);
+    Py_DECREF(allArgs);
+    Py_DECREF(method);
+    return result;
+}
+
+
+// A set-like view of the names that doesn't build any arrays.
+PyObject *ArrayDict_keys(PyObject *self, PyObject *args)
+{
+    if (!reinterpret_cast<ArrayDict *>(self)->keys)
+        return callDictMethod("keys", self, args, nullptr);
+    return PyObject_CallFunctionObjArgs(keysViewType, self, nullptr);
+}
+
+
+// The methods below that take a key build just that array.  The rest
+// need the whole dictionary.
+
+PyObject *ArrayDict_get(PyObject *self, PyObject *args)
+{
+    PyObject *key;
+    PyObject *def = Py_None;
+    if (!PyArg_ParseTuple(args, "O|O:get", &key, &def))
+        return nullptr;
+
+    int found = ArrayDict_contains(self, key);
+    if (found < 0)
+        return nullptr;
+    if (found)
+        return ArrayDict_subscript(self, key);
+    Py_INCREF(def);
+    return def;
+}
+
+
+PyObject *ArrayDict_pop(PyObject *self, PyObject *args)
+{
+    PyObject *key;
+    PyObject *def = nullptr;
+    if (!PyArg_ParseTuple(args, "O|O:pop", &key, &def))
+        return nullptr;
+
+    int found = ArrayDict_contains(self, key);
+    if (found < 0)
+        return nullptr;
+    if (!found)
+    {
+        if (!def)
+        {
+            PyErr_SetObject(PyExc_KeyError, key);
+            return nullptr;
+        }
+        Py_INCREF(def);
+        return def;
+    }
+    PyObject *array = ArrayDict_subscript(self, key);
+    if (array && ArrayDict_ass_subscript(self, key, nullptr))
+        Py_CLEAR(array);
+    return array;
+}
+
+
+PyObject *ArrayDict_setdefault(PyObject *self, PyObject *args)
+{
+    PyObject *key;
+    PyObject *def = Py_None;
+    if (!PyArg_ParseTuple(args, "O|O:setdefault", &key, &def))
+        return nullptr;
+
+    int found = ArrayDict_contains(self, key);
+    if (found < 0)
+        return nullptr;
+    if (found)
+        return ArrayDict_subscript(self, key);
+    if (ArrayDict_ass_subscript(self, key, def))
+        return nullptr;
+    Py_INCREF(def);
+    return def;
+}
+
+
+PyObject *ArrayDict_values(PyObject *self, PyObject *args)
+{
+    return callDictMethod("values", self, args, nullptr);
+}
+
+
+PyObject *ArrayDict_items(PyObject *self, PyObject *args)
+{
+    return callDictMethod("items", self, args, nullptr);
+}
+
+
+PyObject *ArrayDict_copy(PyObject *self, PyObject *args)
+{
+    return callDictMethod("copy", self, args, nullptr);
+}
+
+
+PyObject *ArrayDict_popitem(PyObject *self, PyObject *args)
+{
+    return callDictMethod("popitem", self, args, nullptr);
+}
+
+
+PyObject *ArrayDict_clearMethod(PyObject *self, PyObject *args)
+{
+    return callDictMethod("clear", self, args, nullptr);
+}
+
+
+PyObject *ArrayDict_reversed(PyObject *self, PyObject *args)
+{
+    return callDictMethod("__reversed__", self, args, nullptr);
+}
+
+
+PyObject *ArrayDict_update(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    return callDictMethod("update", self, args, kwargs);
+}
+
+
+PyObject *ArrayDict_or(PyObject *left, PyObject *right)
+{
+    if (PyObject_TypeCheck(left, &ArrayDictType) && expand(left))
+        return nullptr;
+    if (PyObject_TypeCheck(right, &ArrayDictType) && expand(right))
+        return nullptr;
+    return PyDict_Type.tp_as_number->nb_or(left, right);
+}
+
+
+PyObject *ArrayDict_inplace_or(PyObject *self, PyObject *other)
+{
+    if (expand(self))
+        return nullptr;
+    return PyDict_Type.tp_as_number->nb_inplace_or(self, other);
+}
+
+
+PyMappingMethods ArrayDict_mapping =
+{
+    ArrayDict_length,           /* mp_length */
+    ArrayDict_subscript,        /* mp_subscript */
+    ArrayDict_ass_subscript     /* mp_ass_subscript */
+};
+
+
+PySequenceMethods ArrayDict_sequence = {};
+
+
+PyNumberMethods ArrayDict_number = {};
+
+
+PyMethodDef ArrayDict_methods[] =
+{
+    {"keys", ArrayDict_keys, METH_NOARGS, "dict.keys"},
+    {"values", ArrayDict_values, METH_NOARGS, "dict.values"},
+    {"items", ArrayDict_items, METH_NOARGS, "dict.items"},
+    {"get", ArrayDict_get, METH_VARARGS, "dict.get"},
+    {"copy", ArrayDict_copy, METH_NOARGS, "dict.copy"},
+    {"pop", ArrayDict_pop, METH_VARARGS, "dict.pop"},
+    {"popitem", ArrayDict_popitem, METH_NOARGS, "dict.popitem"},
+    {"setdefault", ArrayDict_setdefault, METH_VARARGS, "dict.setdefault"},
+    {"clear", ArrayDict_clearMethod, METH_NOARGS, "dict.clear"},
+    {"__reversed__", ArrayDict_reversed, METH_NOARGS, "dict.__reversed__"},
+    {"update", (PyCFunction)(void(*)(void))ArrayDict_update,
+        METH_VARARGS | METH_KEYWORDS, "dict.update"},
+    {0, 0, 0, 0} // sentinel
+};
+
+
+bool initType()
+{
+    // Free-threaded builds can get here from several threads at once.
+    static std::mutex mutex;
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (ArrayDictType.tp_name)
+        return true;
+
+    PyObject *abc = PyImport_ImportModule("collections.abc");
+    keysViewType = abc ? PyObject_GetAttrString(abc, "KeysView") : nullptr;
+    Py_XDECREF(abc);
+    if (!keysViewType)
+        return false;
+
+    ArrayDict_sequence.sq_contains = ArrayDict_contains;
+    ArrayDict_number.nb_or = ArrayDict_or;
+    ArrayDict_number.nb_inplace_or = ArrayDict_inplace_or;
+
+    ArrayDictType.tp_name = "plang.ArrayDict";
+    ArrayDictType.tp_basicsize = sizeof(ArrayDict);
+    ArrayDictType.tp_dealloc = ArrayDict_dealloc;
+    ArrayDictType.tp_repr = ArrayDict_repr;
+    ArrayDictType.tp_as_number = &ArrayDict_number;
+    ArrayDictType.tp_as_sequence = &ArrayDict_sequence;
+    ArrayDictType.tp_as_mapping = &ArrayDict_mapping;
+    ArrayDictType.tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC;
+    ArrayDictType.tp_doc = "Numpy arrays of PDAL dimensions, built on "
+        "first access";
+    ArrayDictType.tp_traverse = ArrayDict_traverse;
+    ArrayDictType.tp_clear = ArrayDict_clear;
+    ArrayDictType.tp_richcompare = ArrayDict_richcompare;
+    ArrayDictType.tp_iter = ArrayDict_iter;
+    ArrayDictType.tp_methods = ArrayDict_methods;
+    ArrayDictType.tp_base = &PyDict_Type;
+    if (PyType_Ready(&ArrayDictType) < 0)
+    {
+        ArrayDictType.tp_name = nullptr;
+        return false;
+    }
+    return true;
+}
+
+} // unnamed namespace
+
+
+PyObject *newArrayDict(const StringList& names, ArrayLoader loader)
+{
+    gil_scoped_acquire acquire;
+
+    PyObject *keys = PyList_New(0);
+    for (const std::string& name : names)
+    {
+        PyObject *key = PyUnicode_FromString(name.c_str());
+        if (!key || PyList_Append(keys, key))
+        {
+            Py_XDECREF(key);
+            Py_DECREF(keys);
+            throw pdal_error("Unable to add '" + name + "' to the array "
+                "dictionary.");
+        }
+        Py_DECREF(key);
+    }
+    PyObject *d = newArrayDict(keys, loader);
+    Py_DECREF(keys);
+    return d;
+}
+
+
+PyObject *newArrayDict(PyObject *names, ArrayLoader loader)
+{
+    gil_scoped_acquire acquire;
+
+    if (!initType())
+        throw pdal_error("Unable to create the array dictionary type.");
+
+    PyObject *dict = PyObject_CallObject(
+        reinterpret_cast<PyObject *>(&ArrayDictType), nullptr);
+    if (!dict)
+        throw pdal_error("Unable to create an array dictionary.");
+    ArrayDict *d = reinterpret_cast<ArrayDict *>(dict);
+    d->keys = PyList_GetSlice(names, 0, PyList_GET_SIZE(names));
+    if (!d->keys)
+    {
+        Py_DECREF(dict);
+        throw pdal_error("Unable to create an array dictionary.");
+    }
+    d->loader = new ArrayLoader(loader);
+    return dict;
+}
+
+
+void detachArrayDict(PyObject *dict)
+{
+    if (!dict || Py_TYPE(dict) != &ArrayDictType)
+        return;
+
+    // The arrays that weren't built are dropped, leaving a plain dict.
+    if (expand(dict, true))
+        PyErr_Clear();
+    ArrayDict *d = reinterpret_cast<ArrayDict *>(dict);
+    delete d->loader;
+    d->loader = nullptr;
+}
+
+} // namespace plang
+} // namespace pdal
@@ -0,0 +1,77 @@
+/******************************************************************************
+* Copyright (c) 2026, Hobu Inc. (info@hobu.co)
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following
+* conditions are met:
+*
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in
+*       the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of Hobu, Inc. or Flaxen Geo Consulting nor the
+*       names of its contributors may be used to endorse or promote
+*       products derived from this software without specific prior
+*       written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+* COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+* OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+* AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+* OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+* OF SUCH DAMAGE.
+****************************************************************************/
+
+#pragma once
+
+#include <Python.h>
+#undef toupper
+#undef tolower
+#undef isspace
+
+#include <pdal/pdal_internal.hpp>
+
+#include <functional>
+
+// PDAL renamed this but it is not aliased on windows for PDAL 2.9
+#   define PDAL_DLL     PDAL_EXPORT
+
+namespace pdal
+{
+namespace plang
+{
+
+// Builds the named array.  Returns a new reference, or nullptr with a
+// Python exception set.
+typedef std::function<PyObject *(const std::string&)> ArrayLoader;
+
+// Creates a dict subclass of dimension names to numpy arrays that builds
+// each array the first time it's looked up.  Names, len(), 'in', keys(),
+// get(), pop(), setdefault() and item assignment don't build other
+// arrays.  Anything that needs the whole dict, such as items(), values(),
+// update(), copy() or comparison, builds every array first.
+// Returns a new reference.
+PDAL_DLL PyObject *newArrayDict(const StringList& names, ArrayLoader loader);
+
+// As above, with the names given as a list of Python strings.  The list is
+// copied.
+PDAL_DLL PyObject *newArrayDict(PyObject *names, ArrayLoader loader);
+
+// Stops an array dictionary from building arrays.  Arrays that were
+// already built remain available, and it's a plain dict of them from then
+// on.
+PDAL_DLL void detachArrayDict(PyObject *dict);
+
+} // namespace plang
+} // namespace pdal
+
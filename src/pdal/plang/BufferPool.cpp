@@ -0,0 +1,210 @@
+/******************************************************************************
+* Copyright (c) 2026, Hobu Inc. (info@hobu.co)
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following
+* conditions are met:
+*
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in
+*       the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of Hobu, Inc. or Flaxen Geo Consulting nor the
+*       names of its contributors may be used to endorse or promote
+*       products derived from this software without specific prior
+*       written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+* COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+* OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+* AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+* OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+* OF SUCH DAMAGE.
+****************************************************************************/
+
+#include "BufferPool.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iterator>
+
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace pdal
+{
+namespace plang
+{
+
+namespace
+{
+
+const size_t Alignment = 64;
+const size_t HugePageSize = 2 * 1024 * 1024;
+// Released buffers beyond this count are freed rather than kept.
+const size_t MaxFreeBuffers = 64;
+
+const char *CapsuleName = "pdal.plang.buffer";
+
+size_t roundUp(size_t size, size_t alignment)
+{
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+void destroyCapsule(PyObject *capsule)
+{
+    void *buf = PyCapsule_GetPointer(capsule, CapsuleName);
+    BufferPoolPtr *pool = (BufferPoolPtr *)PyCapsule_GetContext(capsule);
+    if (pool)
+    {
+        (*pool)->release(buf);
+        delete pool;
+    }
+}
+
+} // unnamed namespace
+
+
+BufferPool::BufferPool(bool hugePages, size_t maxCachedBytes) :
+    m_hugePages(hugePages), m_maxFreeBytes(maxCachedBytes), m_freeBytes(0)
+{}
+
+
+BufferPool::~BufferPool()
+{
+    for (auto& f : m_free)
+        deallocate(f.second);
+    // Buffers that were acquired but never handed to an array.
+    for (auto& u : m_inUse)
+        deallocate(u.first);
+}
+
+
+void *BufferPool::acquire(size_t size)
+{
+    size_t capacity = roundUp((std::max)(size, (size_t)1), Alignment);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // Reuse the smallest released buffer that's big enough, as long as
+    // it isn't so big that most of it would be wasted.
+    auto it = m_free.lower_bound(capacity);
+    if (it != m_free.end() && it->first / 2 <= capacity)
+    {
+        void *buf = it->second;
+        m_freeBytes -= it->first;
+        m_inUse[buf] = it->first;
+        m_free.erase(it);
+        return buf;
+    }
+
+    if (m_hugePages && capacity >= HugePageSize)
+        capacity = roundUp(capacity, HugePageSize);
+    void *buf = allocate(capacity);
+    m_inUse[buf] = capacity;
+    return buf;
+}
+
+
+void BufferPool::release(void *buf)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_inUse.find(buf);
+    if (it == m_inUse.end())
+        return;
+    size_t capacity = it->second;
+    m_inUse.erase(it);
+
+    // A buffer too big to keep is freed.  Otherwise the largest released
+    // buffers are freed to make room for it, since the sizes in use now
+    // are the ones most likely to be asked for again.
+    if (capacity > m_maxFreeBytes)
+    {
+        deallocate(buf);
+        return;
+    }
+    while (m_free.size() &&
+        (m_free.size() >= MaxFreeBuffers ||
+            m_freeBytes + capacity > m_maxFreeBytes))
+    {
+        auto largest = std::prev(m_free.end());
+        m_freeBytes -= largest->first;
+        deallocate(largest->second);
+        m_free.erase(largest);
+    }
+    m_free.insert(std::make_pair(capacity, buf));
+    m_freeBytes += capacity;
+}
+
+
+size_t BufferPool::cachedBytes() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_freeBytes;
+}
+
+
+void *BufferPool::allocate(size_t capacity)
+{
+    const bool huge = m_hugePages && capacity >= HugePageSize;
+    const size_t alignment = huge ? HugePageSize : Alignment;
+
+    void *buf;
+#ifdef _WIN32
+    buf = _aligned_malloc(capacity, alignment);
+#else
+    if (posix_memalign(&buf, alignment, capacity))
+        buf = nullptr;
+#endif
+    if (!buf)
+        throw pdal_error("Unable to allocate " + std::to_string(capacity) +
+            " bytes for numpy array.");
+
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    // Only a hint.  If it's refused we get normal pages.
+    if (huge)
+        (void)madvise(buf, capacity, MADV_HUGEPAGE);
+#endif
+    return buf;
+}
+
+
+void BufferPool::deallocate(void *buf)
+{
+#ifdef _WIN32
+    _aligned_free(buf);
+#else
+    free(buf);
+#endif
+}
+
+
+PyObject *bufferCapsule(BufferPoolPtr pool, void *buf)
+{
+    PyObject *capsule = PyCapsule_New(buf, CapsuleName, destroyCapsule);
+    if (!capsule)
+    {
+        pool->release(buf);
+        return nullptr;
+    }
+    PyCapsule_SetContext(capsule, new BufferPoolPtr(pool));
+    return capsule;
+}
+
+} // namespace plang
+} // namespace pdal
+
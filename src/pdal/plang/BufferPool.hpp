@@ -0,0 +1,107 @@
+/******************************************************************************
+* Copyright (c) 2026, Hobu Inc. (info@hobu.co)
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following
+* conditions are met:
+*
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in
+*       the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of Hobu, Inc. or Flaxen Geo Consulting nor the
+*       names of its contributors may be used to endorse or promote
+*       products derived from this software without specific prior
+*       written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+* COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+* OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+* AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+* OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+* OF SUCH DAMAGE.
+****************************************************************************/
+
+#pragma once
+
+#include <Python.h>
+#undef toupper
+#undef tolower
+#undef isspace
+
+#include <pdal/pdal_internal.hpp>
+
+#include <map>
+#include <memory>
+#include <mutex>
+
+// PDAL renamed this but it is not aliased on windows for PDAL 2.9
+#   define PDAL_DLL     PDAL_EXPORT
+
+namespace pdal
+{
+namespace plang
+{
+
+class BufferPool;
+typedef std::shared_ptr<BufferPool> BufferPoolPtr;
+
+// Hands out aligned buffers for marshaled arrays and keeps released
+// buffers for reuse, so that processing many views doesn't allocate and
+// free the same sizes over and over.
+class PDAL_DLL BufferPool
+{
+public:
+    static const size_t DefaultMaxCachedBytes = 256 * 1024 * 1024;
+
+    // If 'hugePages' is set, large buffers are aligned to and advised as
+    // transparent huge pages where the platform supports it.  At most
+    // 'maxCachedBytes' are kept in released buffers.
+    BufferPool(bool hugePages = false,
+        size_t maxCachedBytes = DefaultMaxCachedBytes);
+    ~BufferPool();
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    // Returns a buffer of at least 'size' bytes.
+    void *acquire(size_t size);
+    // Returns a buffer obtained from acquire() to the pool.
+    void release(void *buf);
+
+    // Number of bytes held in released buffers.
+    size_t cachedBytes() const;
+
+private:
+    void *allocate(size_t capacity);
+    void deallocate(void *buf);
+
+    bool m_hugePages;
+    size_t m_maxFreeBytes;
+    mutable std::mutex m_mutex;
+    // Capacity of every buffer handed out.
+    std::map<void *, size_t> m_inUse;
+    // Released buffers by capacity.
+    std::multimap<size_t, void *> m_free;
+    size_t m_freeBytes;
+};
+
+// Creates a capsule that returns 'buf' to 'pool' when it's destroyed.
+// Set it as the base object of a numpy array to have the array own the
+// buffer.  The pool lives at least as long as the capsule.
+// Returns a new reference.
+PDAL_DLL PyObject *bufferCapsule(BufferPoolPtr pool, void *buf);
+
+} // namespace plang
+} // namespace pdal
+
@@ -0,0 +1,190 @@
+/******************************************************************************
+* Copyright (c) 2026, Hobu Inc. (info@hobu.co)
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following
+* conditions are met:
+*
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in
+*       the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of Hobu, Inc. or Flaxen Geo Consulting nor the
+*       names of its contributors may be used to endorse or promote
+*       products derived from this software without specific prior
+*       written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+* COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+* OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+* AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+* OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+* OF SUCH DAMAGE.
+****************************************************************************/
+
+#include "CodeCache.hpp"
+#include "Environment.hpp"
+
+#include <pdal/util/FileUtils.hpp>
+
+#include <marshal.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+namespace pdal
+{
+namespace plang
+{
+
+namespace
+{
+
+void appendSize(std::string& s, uint64_t size)
+{
+    s.append(reinterpret_cast<const char *>(&size), sizeof(size));
+}
+
+// Everything the code depends on.  It's written at the start of each
+// entry and compared on load, so a hash collision can't return the
+// wrong code.
+std::string entryKey(const Script& script)
+{
+    const uint32_t magic = (uint32_t)PyImport_GetMagicNumber();
+    const std::string source(script.source());
+    const std::string module(script.module());
+
+    std::string key(reinterpret_cast<const char *>(&magic), sizeof(magic));
+    appendSize(key, source.size());
+    appendSize(key, module.size());
+    key += source;
+    key += module;
+    return key;
+}
+
+// 64-bit FNV-1a.
+uint64_t hash(const std::string& s)
+{
+    uint64_t h = 14695981039346656037ULL;
+    for (unsigned char c : s)
+    {
+        h ^= c;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+std::string entryPath(const std::string& cacheDir, const std::string& key)
+{
+    std::ostringstream oss;
+    oss << cacheDir << "/" << std::hex << std::setw(16) <<
+        std::setfill('0') << hash(key) << ".code";
+    return oss.str();
+}
+
+// Returns a new reference to the cached code, or nullptr if there's no
+// usable entry.
+PyObject *load(const std::string& path, const std::string& key)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        return nullptr;
+    std::string data((std::istreambuf_iterator<char>(in)),
+        std::istreambuf_iterator<char>());
+    if (data.size() <= key.size() || data.compare(0, key.size(), key) != 0)
+        return nullptr;
+
+    PyObject *code = PyMarshal_ReadObjectFromString(
+        data.data() + key.size(), (Py_ssize_t)(data.size() - key.size()));
+    if (!code)
+    {
+        PyErr_Clear();
+        return nullptr;
+    }
+    if (!PyCode_Check(code))
+    {
+        Py_DECREF(code);
+        return nullptr;
+    }
+    return code;
+}
+
+// Entries are written to a temporary file and renamed, so that processes
+// starting at the same time never read a partial entry.
+void store(const std::string& cacheDir, const std::string& path,
+    const std::string& key, PyObject *code)
+{
+    PyObject *bytes = PyMarshal_WriteObjectToString(code, Py_MARSHAL_VERSION);
+    if (!bytes)
+    {
+        PyErr_Clear();
+        return;
+    }
+
+    (void)FileUtils::createDirectories(cacheDir);
+    std::ostringstream tmp;
+    tmp << path << "." << getpid() << "." <<
+        std::hash<std::thread::id>()(std::this_thread::get_id()) << ".tmp";
+    bool ok;
+    {
+        std::ofstream out(tmp.str(), std::ios::binary);
+        out.write(key.data(), key.size());
+        out.write(PyBytes_AS_STRING(bytes), PyBytes_GET_SIZE(bytes));
+        out.close();
+        ok = (bool)out;
+    }
+    Py_DECREF(bytes);
+    if (!ok || std::rename(tmp.str().c_str(), path.c_str()) != 0)
+        std::remove(tmp.str().c_str());
+}
+
+} // unnamed namespace
+
+
+PyObject *compileScript(const Script& script, const std::string& cacheDir)
+{
+    std::string key;
+    std::string path;
+    if (cacheDir.size())
+    {
+        key = entryKey(script);
+        path = entryPath(cacheDir, key);
+        PyObject *code = load(path, key);
+        if (code)
+            return code;
+    }
+
+    PyObject *code = Py_CompileString(script.source(), script.module(),
+        Py_file_input);
+    if (!code)
+        throw pdal_error(getTraceback());
+
+    if (cacheDir.size())
+        store(cacheDir, path, key, code);
+    return code;
+}
+
+} // namespace plang
+} // namespace pdal
@@ -262,6 +262,23 @@ std::string getTraceback()
     return mssg.str();
 }
 
+PyObject *getItemRef(PyObject *dict, const char *key)
+{
+#if PY_VERSION_HEX >= 0x030D0000
+    PyObject *item;
+    if (PyDict_GetItemStringRef(dict, key, &item) < 0)
+    {
+        PyErr_Clear();
+        return nullptr;
+    }
+    return item;
+#else
+    PyObject *item = PyDict_GetItemString(dict, key);
+    Py_XINCREF(item);
+    return item;
+#endif
+}
+
 // Returns a new reference.
 PyObject *fromMetadata(MetadataNode m)
 {
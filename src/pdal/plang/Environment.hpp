@@ -67,6 +67,11 @@ PDAL_DLL void addMetadata(PyObject *list, MetadataNode m);
 
 PDAL_DLL std::string getTraceback();
 
+// Returns a new reference to dict[key], or nullptr if it isn't set.
+// Unlike a borrowed reference, it stays valid if another thread replaces
+// the entry.
+PDAL_DLL PyObject *getItemRef(PyObject *dict, const char *key);
+
 class Environment;
 typedef Environment *EnvironmentPtr;
 
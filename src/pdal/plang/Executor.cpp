@@ -0,0 +1,126 @@
+/******************************************************************************
+* Copyright (c) 2026, Hobu Inc. (info@hobu.co)
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following
+* conditions are met:
+*
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in
+*       the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of Hobu, Inc. or Flaxen Geo Consulting nor the
+*       names of its contributors may be used to endorse or promote
+*       products derived from this software without specific prior
+*       written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+* COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+* OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+* AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+* OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+* OF SUCH DAMAGE.
+****************************************************************************/
+
+#include "Executor.hpp"
+#include "Environment.hpp"
+#include "gil.hpp"
+
+#include <future>
+#include <memory>
+
+namespace pdal
+{
+namespace plang
+{
+
+Executor& Executor::get()
+{
+    static std::once_flag flag;
+    static Executor *executor = nullptr;
+
+    // Never destroyed.  The thread waits for work until the process ends.
+    std::call_once(flag, []()
+    {
+        Environment::get();
+        executor = new Executor;
+    });
+    return *executor;
+}
+
+
+Executor::Executor()
+{
+    std::thread thread(&Executor::loop, this);
+    m_threadId = thread.get_id();
+    thread.detach();
+}
+
+
+void Executor::run(const std::function<void()>& task)
+{
+    // A task that runs more Python work would wait for itself.
+    if (std::this_thread::get_id() == m_threadId)
+    {
+        gil_scoped_acquire acquire;
+        task();
+        return;
+    }
+
+    std::shared_ptr<std::packaged_task<void()>> job(
+        new std::packaged_task<void()>(task));
+    std::future<void> done = job->get_future();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.push_back([job]() { (*job)(); });
+    }
+    m_cv.notify_one();
+
+    if (PyGILState_Check())
+    {
+        gil_scoped_release release;
+        done.wait();
+    }
+    done.get();
+}
+
+
+void Executor::loop()
+{
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cv.wait(lock, [this]() { return m_queue.size(); });
+        }
+
+        // The queue isn't locked while waiting for the GIL, since a
+        // thread that holds the GIL may be adding to it.
+        gil_scoped_acquire acquire;
+        while (true)
+        {
+            std::function<void()> task;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (m_queue.empty())
+                    break;
+                task = std::move(m_queue.front());
+                m_queue.pop_front();
+            }
+            task();
+        }
+    }
+}
+
+} // namespace plang
+} // namespace pdal
@@ -33,9 +33,16 @@
 ****************************************************************************/
 
 #include "Invocation.hpp"
+#include "ArrayDict.hpp"
+#include "ModuleRegistry.hpp"
+#include "MetadataDict.hpp"
 
 #include <pdal/util/Algorithm.hpp>
 
+#include <cstring>
+#include <exception>
+#include <mutex>
+
 #define NO_IMPORT_ARRAY
 #include <numpy/ndarrayobject.h>
 
@@ -109,6 +116,67 @@ void addGlobalObject(PyObject* module, PyObject* obj, const std::string& name)
         throw pdal::pdal_error("Unable to set" + name + "global");
 }
 
+// Points are marshaled in slices of at least this many points per
+// thread, so that small views aren't split up.
+const pdal::point_count_t MinSlicePoints = 65536;
+
+// An output array that's to be copied into the view.
+struct OutputArray
+{
+    pdal::Dimension::Id m_id;
+    const pdal::Dimension::Detail *m_detail;
+    PyArrayObject *m_array;
+    pdal::point_count_t m_count;
+};
+
+// Moves an array that views point table memory onto a copy of its data.
+// Returns false if the copy can't be made.
+bool detachAlias(PyArrayObject *array)
+{
+    PyArrayObject *copy =
+        (PyArrayObject *)PyArray_NewCopy(array, NPY_CORDER);
+    if (!copy)
+        return false;
+
+    // The array is one-dimensional and has no base, so it can take the
+    // copy as the owner of its new data.
+    PyArrayObject_fields *fields = (PyArrayObject_fields *)array;
+    fields->data = PyArray_BYTES(copy);
+    fields->strides[0] = PyArray_STRIDE(copy, 0);
+    PyArray_SetBaseObject(array, (PyObject *)copy);
+    PyArray_UpdateFlags(array, NPY_ARRAY_UPDATE_ALL);
+    return true;
+}
+
+// Owns a reference, which is released when it goes out of scope.  The
+// GIL must be held.
+class PyRef
+{
+public:
+    explicit PyRef(PyObject *obj) : m_obj(obj)
+    {}
+    ~PyRef()
+        { Py_XDECREF(m_obj); }
+
+    PyRef(const PyRef&) = delete;
+    PyRef& operator=(const PyRef&) = delete;
+
+    PyObject *get() const
+        { return m_obj; }
+    void reset()
+        { Py_CLEAR(m_obj); }
+
+private:
+    PyObject *m_obj;
+};
+
+// Invocations running at once may share a point table, which isn't
+// thread-safe.  Views are numbered from a shared counter, too.  The GIL
+// keeps them apart on most builds, but not on free-threaded ones, so
+// views are made and the table's structure is read or changed with this
+// held.
+std::mutex tableMutex;
+
 } // unnamed namespace
 
 namespace pdal
@@ -116,35 +184,41 @@ namespace pdal
 namespace plang
 {
 Invocation::Invocation(const Script& script, MetadataNode m,
-        const std::string& pdalArgs) :
-    m_script(script), m_inputMetadata(m), m_pdalargs(pdalArgs)
+        const std::string& pdalArgs, const std::string& cacheDir,
+        bool isolated) :
+    m_script(script), m_pool(new BufferPool), m_aliased(false),
+    m_inputMetadata(m), m_pdalargs(pdalArgs), m_zeroCopy(false),
+    m_structured(false), m_numThreads(1)
 {
     Environment::get();
     gil_scoped_acquire acquire;
-    compile();
+    compile(cacheDir, isolated);
 }
 
 
-void Invocation::compile()
+Invocation::~Invocation()
 {
-    PyObject *bytecode = Py_CompileString(m_script.source(), m_script.module(),
-        Py_file_input);
-    if (!bytecode)
-        throw pdal_error(getTraceback());
+    gil_scoped_acquire acquire;
+    Py_XDECREF(m_function);
+    Py_XDECREF(m_module);
+    Py_XDECREF(m_plan.m_keys);
+    Py_XDECREF(m_plan.m_pdalargs);
+    Py_XDECREF(m_plan.m_schema);
+    Py_XDECREF(m_plan.m_srs);
+}
 
-    m_module = PyImport_ExecCodeModule(const_cast<char*>(m_script.module()),
-        bytecode);
 
-    Py_DECREF(bytecode);
-    if (!m_module)
-        throw pdal_error(getTraceback());
+void Invocation::compile(const std::string& cacheDir, bool isolated)
+{
+    m_module = loadModule(m_script, cacheDir, isolated);
 
     PyObject *dictionary = PyModule_GetDict(m_module);
     if (!dictionary)
         throw pdal_error("Unable to fetch module dictionary");
 
-    // Owned by the module through the dictionary.
-    m_function = PyDict_GetItemString(dictionary, m_script.function());
+    // Another invocation of the same module replaces the dictionary's
+    // entry, so a reference is kept.
+    m_function = getItemRef(dictionary, m_script.function());
     if (!m_function)
     {
         std::ostringstream oss;
@@ -154,14 +228,18 @@ void Invocation::compile()
     }
 
     if (!PyCallable_Check(m_function))
+    {
+        Py_CLEAR(m_function);
         throw pdal_error(getTraceback());
+    }
+    m_numArgs = argCount(m_function);
 }
 
 
 // creates a Python variable pointing to a (one dimensional) C array
 // Returns a new reference to the numpy array.
-PyObject * Invocation::addArray(std::string const& name, uint8_t* data,
-    Dimension::Type t, point_count_t count)
+PyObject * Invocation::addArray(uint8_t* data, Dimension::Type t,
+    point_count_t count)
 {
     npy_intp mydims = count;
     int nd = 1;
@@ -181,55 +259,157 @@ PyObject * Invocation::addArray(std::string const& name, uint8_t* data,
 }
 
 
+// Creates a writable numpy array over a dimension stored in point table
+// memory.  'stride' is the distance between consecutive points.
+// Returns a new reference to the numpy array.
+PyObject *Invocation::aliasArray(uint8_t *data, Dimension::Type t,
+    point_count_t count, size_t stride)
+{
+    npy_intp dims = count;
+    npy_intp strides = stride;
+
+    const int pyDataType = plang::Environment::getPythonDataType(t);
+    PyObject *array = PyArray_New(&PyArray_Type, 1, &dims, pyDataType,
+        &strides, data, 0, NPY_ARRAY_WRITEABLE, NULL);
+    if (!array)
+        throw pdal_error(getTraceback());
+
+    // Dimensions aren't necessarily aligned within a point, so let numpy
+    // work out the alignment and contiguity flags.
+    PyArray_UpdateFlags((PyArrayObject *)array, NPY_ARRAY_UPDATE_ALL);
+    return array;
+}
+
+
+void Invocation::setThreads(size_t numThreads)
+{
+    m_numThreads = (std::max)(numThreads, (size_t)1);
+    if (m_numThreads > 1)
+        m_workers.reset(new ThreadPool(m_numThreads));
+    else
+        m_workers.reset();
+}
+
+
+void Invocation::afterFork()
+{
+    // The pool can't even be destroyed without its threads.
+    (void)m_workers.release();
+    m_numThreads = 1;
+}
+
+
+// Runs marshaling tasks on the worker threads and waits for them.
+void Invocation::runTasks(std::vector<std::function<void()>>& tasks)
+{
+    plang::runTasks(m_workers.get(), tasks);
+}
+
+
 bool Invocation::execute(PointViewPtr& v, MetadataNode stageMetadata)
 {
-    if (!m_module)
-        throw pdal_error("No code has been compiled");
+    PointViewSet views;
+    bool ok = execute(v, stageMetadata, views);
+    if (views.size() != 1)
+        throw pdal_error("'Split' output array must have a single label "
+            "here.");
+    v = *views.begin();
+    return ok;
+}
 
-    PyObject *inArrays = prepareData(v);
-    PyObject *outArrays(nullptr);
 
-    // New object.
-    Py_ssize_t numArgs = argCount(m_function);
-    PyObject *scriptArgs = PyTuple_New(numArgs);
+bool Invocation::execute(PointViewPtr& v, MetadataNode stageMetadata,
+    PointViewSet& views, std::vector<int64_t> *labels)
+{
+    if (labels)
+        labels->clear();
+    if (!m_module)
+        throw pdal_error("No code has been compiled");
 
-    if (numArgs > 2)
+    if (m_numArgs > 2)
         throw pdal_error("Only two arguments -- ins and outs "
             "numpy arrays -- can be passed!");
 
-    // inArrays and outArrays are owned by scriptArgs here.
-    PyTuple_SetItem(scriptArgs, 0, inArrays);
-    if (numArgs > 1)
-    {
-        outArrays = PyDict_New();
-        PyTuple_SetItem(scriptArgs, 1, outArrays);
-    }
+    PyRef inArrays(prepareData(v));
 
-    PyObject *scriptResult = PyObject_CallObject(m_function, scriptArgs);
-    if (!scriptResult)
+    // Input arrays that view the table are let go when the call is done.
+    struct AliasGuard
+    {
+        Invocation& m_invocation;
+        ~AliasGuard()
+            { m_invocation.releaseAliases(); }
+    } aliasGuard { *this };
+
+    PyRef outArrays(m_numArgs > 1 ? PyDict_New() : nullptr);
+
+    PyObject *scriptArgs[] = { inArrays.get(), outArrays.get() };
+    PyRef scriptResult(PyObject_Vectorcall(m_function, scriptArgs,
+        m_numArgs, nullptr));
+
+    // Workers running the same module may rebind 'out_metadata' as soon
+    // as anything lets go of the GIL, so it's read straight away.
+    PyRef outMetadata(scriptResult.get() ?
+        getItemRef(PyModule_GetDict(m_module), "out_metadata") : nullptr);
+
+    // The view may not outlive this call, so arrays that weren't built
+    // can't be built later.
+    detachArrayDict(inArrays.get());
+    inArrays.reset();
+    if (!scriptResult.get())
         throw pdal_error(getTraceback());
-    if (!PyBool_Check(scriptResult))
+    if (!PyBool_Check(scriptResult.get()))
         throw pdal_error("User function return value not boolean.");
 
-    PyObject *maskArray = PyDict_GetItemString(outArrays, "Mask");
+    // Functions that only take 'ins' have no outputs.
+    PyObject *outs = outArrays.get();
+    PyObject *maskArray(nullptr);
+    PyObject *packedMaskArray(nullptr);
+    PyObject *indexArray(nullptr);
+    PyObject *splitArray(nullptr);
+    if (outs)
+    {
+        maskArray = PyDict_GetItemString(outs, "Mask");
+        packedMaskArray = PyDict_GetItemString(outs, "PackedMask");
+        indexArray = PyDict_GetItemString(outs, "Indices");
+        splitArray = PyDict_GetItemString(outs, "Split");
+    }
     if (maskArray)
     {
-        if (PyDict_Size(outArrays) > 1)
+        if (PyDict_Size(outs) > 1)
             throw pdal_error("'Mask' output array must be the only "
                 "output array.");
-        v = maskData(v, maskArray);
+        v = maskData(v, maskArray, false);
+    }
+    else if (packedMaskArray)
+    {
+        if (PyDict_Size(outs) > 1)
+            throw pdal_error("'PackedMask' output array must be the only "
+                "output array.");
+        v = maskData(v, packedMaskArray, true);
+    }
+    else if (indexArray)
+    {
+        if (PyDict_Size(outs) > 1)
+            throw pdal_error("'Indices' output array must be the only "
+                "output array.");
+        v = indexData(v, indexArray);
+    }
+    else if (splitArray)
+    {
+        if (PyDict_Size(outs) > 1)
+            throw pdal_error("'Split' output array must be the only "
+                "output array.");
+        splitData(v, splitArray, views, labels);
     }
     else
-        extractData(v, outArrays);
-    extractMetadata(stageMetadata);
+        extractData(v, outs);
+    if (!splitArray)
+        views.insert(v);
+    extractMetadata(stageMetadata, outMetadata.get());
 
     // This looks weird, but booleans are implemented as static objects,
     // allowing this comparison (Py_True is a pointer to the "true" object.)
-    bool ok = scriptResult == Py_True;
-
-    Py_DECREF(scriptArgs);
-    Py_DECREF(scriptResult);
-    return ok;
+    return scriptResult.get() == Py_True;
 }
 
 
@@ -363,72 +543,457 @@ PyObject* getPyJSON(std::string const& s)
 PyObject *Invocation::prepareData(PointViewPtr& view)
 {
     gil_scoped_acquire acquire;
-    PointLayoutPtr layout(view->table().layout());
-    Dimension::IdList const& dims = layout->dims();
 
-    PyObject *arrays = PyDict_New();
-    for (auto di = dims.begin(); di != dims.end(); ++di)
+    m_aliases.clear();
     {
-        Dimension::Id d = *di;
-        const Dimension::Detail *dd = layout->dimDetail(d);
-        Dimension::Type dimType = view->dimType(d);
-        void *data = malloc(dd->size() * view->size());
-        char *p = (char *)data;
-        for (PointId idx = 0; idx < view->size(); ++idx)
+        std::lock_guard<std::mutex> lock(tableMutex);
+        m_runs = findRuns(*view);
+    }
+
+    // If the points are contiguous in table memory, hand the script
+    // views of the table itself rather than copies.
+    m_aliased = m_zeroCopy && m_runs.size() == 1;
+
+    updatePlan(*view);
+
+    PyObject *arrays;
+    if (m_structured)
+        arrays = loadRecords(*view, m_plan.m_names);
+    else
+    {
+        // Arrays are only built for the dimensions the script looks at.
+        PointViewPtr v(view);
+        arrays = newArrayDict(m_plan.m_keys,
+            [this, v](const std::string& name)
+            { return loadArray(*v, name); });
+    }
+
+    // The module takes a reference to each global.
+    auto addCached = [this](PyObject *obj, const std::string& name)
+    {
+        Py_XINCREF(obj);
+        addGlobalObject(m_module, obj, name);
+    };
+
+    addGlobalObject(m_module, newMetadataDict(m_inputMetadata), "metadata");
+    addCached(m_plan.m_pdalargs, "pdalargs");
+    addCached(m_plan.m_schema, "schema");
+    addCached(m_plan.m_srs, "spatialreference");
+
+    return arrays;
+}
+
+
+// Rebuilds the parts of the call plan that depend on the view's layout or
+// spatial reference if they've changed since the last view.
+void Invocation::updatePlan(PointView& view)
+{
+    PointLayoutPtr layout(view.table().layout());
+
+    if (!m_plan.m_pdalargs)
+        m_plan.m_pdalargs = getPyJSON(m_pdalargs);
+
+    if (layout != m_plan.m_layout || layout->dims() != m_plan.m_dims)
+    {
+        m_plan.m_layout = layout;
+        m_plan.m_dims = layout->dims();
+
+        m_plan.m_names = m_inputDims;
+        if (m_plan.m_names.empty())
+            for (Dimension::Id d : layout->dims())
+                m_plan.m_names.push_back(layout->dimName(d));
+
+        PyObject *keys = PyList_New(0);
+        for (const std::string& name : m_plan.m_names)
         {
-            view->getField((char*)p, d, dimType, idx);
-            p += dd->size();
+            PyObject *key = PyUnicode_InternFromString(name.c_str());
+            if (!key || PyList_Append(keys, key))
+            {
+                Py_XDECREF(key);
+                Py_DECREF(keys);
+                throw pdal_error(getTraceback());
+            }
+            Py_DECREF(key);
         }
-        std::string name = layout->dimName(*di);
-        PyObject *array = addArray(name, (uint8_t *)data, dd->type(),
-            view->size());
-        PyDict_SetItemString(arrays, name.c_str(), array);
+        Py_XDECREF(m_plan.m_keys);
+        m_plan.m_keys = keys;
 
-        m_pyInputArrays.push_back(array);  // Hold for de-referencing.
-        m_numpyBuffers.push_back(data);    // Hold for deallocation
+        MetadataNode layoutMeta = layout->toMetadata();
+        Py_XDECREF(m_plan.m_schema);
+        m_plan.m_schema = getPyJSON(Utils::toJSON(layoutMeta));
     }
 
-    MetadataNode layoutMeta = view->layout()->toMetadata();
-    MetadataNode srsMeta = view->spatialReference().toMetadata();
+    SpatialReference srs = view.spatialReference();
+    if (!m_plan.m_srs || srs != m_plan.m_srsValue)
+    {
+        m_plan.m_srsValue = srs;
+        MetadataNode srsMeta = srs.toMetadata();
+        Py_XDECREF(m_plan.m_srs);
+        m_plan.m_srs = getPyJSON(Utils::toJSON(srsMeta));
+    }
+}
 
-    addGlobalObject(m_module, plang::fromMetadata(m_inputMetadata), "metadata");
-    addGlobalObject(m_module, getPyJSON(m_pdalargs), "pdalargs");
-    addGlobalObject(m_module, getPyJSON(Utils::toJSON(layoutMeta)), "schema");
-    addGlobalObject(m_module, getPyJSON(Utils::toJSON(srsMeta)),
-        "spatialreference");
 
-    return arrays;
+// Creates the numpy array for a dimension.
+// Returns a new reference.
+PyObject *Invocation::loadArray(PointView& view, const std::string& name)
+{
+    PointLayoutPtr layout(view.table().layout());
+    Dimension::Id d = layout->findDim(name);
+    if (d == Dimension::Id::Unknown)
+        throw pdal_error("Can't create numpy array '" + name +
+            "' as input.  Dimension not registered.");
+    const Dimension::Detail *dd = layout->dimDetail(d);
+    const size_t pointSize = layout->pointSize();
+
+    if (m_aliased)
+    {
+        uint8_t *data = (uint8_t *)(m_runs[0].m_base + dd->offset());
+        m_aliases[name] = data;
+        PyObject *array = aliasArray(data, dd->type(), view.size(),
+            pointSize);
+        Py_INCREF(array);
+        m_aliasArrays.push_back(array);
+        return array;
+    }
+
+    // The array owns its buffer through a capsule, which returns the
+    // buffer to the pool when the array is released.
+    void *data = m_pool->acquire(dd->size() * view.size());
+    PyObject *owner = bufferCapsule(m_pool, data);
+    if (!owner)
+        throw pdal_error(getTraceback());
+
+    try
+    {
+        gil_scoped_release release;
+
+        char *p = (char *)data;
+        if (m_runs.size())
+        {
+            const size_t offset = dd->offset();
+            const size_t size = dd->size();
+            RunSliceList slices = splitRuns(m_runs, pointSize, m_numThreads,
+                MinSlicePoints);
+            std::vector<std::function<void()>> tasks;
+            for (const RunSlice& s : slices)
+            {
+                const RunSlice *slice = &s;
+                tasks.push_back([=]()
+                {
+                    gatherDim(slice->m_runs, pointSize, offset, size,
+                        p + slice->m_start * size);
+                });
+            }
+            runTasks(tasks);
+        }
+        else
+        {
+            for (PointId idx = 0; idx < view.size(); ++idx)
+            {
+                view.getField(p, d, dd->type(), idx);
+                p += dd->size();
+            }
+        }
+    }
+    catch (...)
+    {
+        Py_DECREF(owner);
+        throw;
+    }
+
+    PyObject *array = addArray((uint8_t *)data, dd->type(), view.size());
+    if (!array)
+    {
+        Py_DECREF(owner);
+        throw pdal_error(getTraceback());
+    }
+    // Steals the reference to owner, even on failure.
+    if (PyArray_SetBaseObject((PyArrayObject *)array, owner) < 0)
+    {
+        Py_DECREF(array);
+        throw pdal_error(getTraceback());
+    }
+    return array;
 }
 
 
-PointViewPtr Invocation::maskData(PointViewPtr& view, PyObject *maskArray)
+// Creates a structured numpy array with a field for each named dimension.
+// The record layout matches the point layout, so points stored by row are
+// copied a run at a time.
+// Returns a new reference.
+PyObject *Invocation::loadRecords(PointView& view, const StringList& names)
 {
-    PointViewPtr outView = view->makeNew();
+    PointLayoutPtr layout(view.table().layout());
+    const size_t pointSize = layout->pointSize();
+
+    std::vector<Dimension::Id> dims;
+    PyObject *fieldNames = PyList_New(0);
+    PyObject *formats = PyList_New(0);
+    PyObject *offsets = PyList_New(0);
+    for (const std::string& name : names)
+    {
+        Dimension::Id d = layout->findDim(name);
+        if (d == Dimension::Id::Unknown)
+            throw pdal_error("Can't create numpy array field '" + name +
+                "' as input.  Dimension not registered.");
+        const Dimension::Detail *dd = layout->dimDetail(d);
+        dims.push_back(d);
+
+        PyObject *n = PyUnicode_FromString(name.c_str());
+        PyObject *f = (PyObject *)PyArray_DescrFromType(
+            plang::Environment::getPythonDataType(dd->type()));
+        PyObject *o = PyLong_FromSize_t(dd->offset());
+        PyList_Append(fieldNames, n);
+        PyList_Append(formats, f);
+        PyList_Append(offsets, o);
+        Py_DECREF(n);
+        Py_DECREF(f);
+        Py_DECREF(o);
+    }
+
+    PyObject *spec = PyDict_New();
+    PyObject *itemsize = PyLong_FromSize_t(pointSize);
+    PyDict_SetItemString(spec, "names", fieldNames);
+    PyDict_SetItemString(spec, "formats", formats);
+    PyDict_SetItemString(spec, "offsets", offsets);
+    PyDict_SetItemString(spec, "itemsize", itemsize);
+    Py_DECREF(fieldNames);
+    Py_DECREF(formats);
+    Py_DECREF(offsets);
+    Py_DECREF(itemsize);
+
+    PyArray_Descr *dtype(nullptr);
+    int ok = PyArray_DescrConverter(spec, &dtype);
+    Py_DECREF(spec);
+    if (!ok)
+        throw pdal_error(getTraceback());
+
+    npy_intp count = view.size();
+    PyObject *array;
+    if (m_aliased)
+    {
+        // Fields are views of the table.
+        char *base = m_runs[0].m_base;
+        for (size_t i = 0; i < names.size(); ++i)
+            m_aliases[names[i]] = (uint8_t *)(base +
+                layout->dimDetail(dims[i])->offset());
+        array = PyArray_NewFromDescr(&PyArray_Type, dtype, 1, &count,
+            NULL, base, NPY_ARRAY_WRITEABLE, NULL);
+        if (!array)
+            throw pdal_error(getTraceback());
+        PyArray_UpdateFlags((PyArrayObject *)array, NPY_ARRAY_UPDATE_ALL);
+        Py_INCREF(array);
+        m_aliasArrays.push_back(array);
+        return array;
+    }
+
+    void *data = m_pool->acquire(pointSize * view.size());
+    PyObject *owner = bufferCapsule(m_pool, data);
+    if (!owner)
+    {
+        Py_DECREF(dtype);
+        throw pdal_error(getTraceback());
+    }
+
+    try
+    {
+        gil_scoped_release release;
 
+        char *p = (char *)data;
+        if (m_runs.size())
+        {
+            RunSliceList slices = splitRuns(m_runs, pointSize, m_numThreads,
+                MinSlicePoints);
+            std::vector<std::function<void()>> tasks;
+            for (const RunSlice& s : slices)
+            {
+                const RunSlice *slice = &s;
+                tasks.push_back([=]()
+                {
+                    char *dst = p + slice->m_start * pointSize;
+                    for (const PointRun& r : slice->m_runs)
+                    {
+                        std::memcpy(dst, r.m_base, r.m_count * pointSize);
+                        dst += r.m_count * pointSize;
+                    }
+                });
+            }
+            runTasks(tasks);
+        }
+        else
+        {
+            for (PointId idx = 0; idx < view.size(); ++idx)
+            {
+                for (Dimension::Id d : dims)
+                {
+                    const Dimension::Detail *dd = layout->dimDetail(d);
+                    view.getField(p + dd->offset(), d, dd->type(), idx);
+                }
+                p += pointSize;
+            }
+        }
+    }
+    catch (...)
+    {
+        Py_DECREF(owner);
+        Py_DECREF(dtype);
+        throw;
+    }
+
+    // Steals the reference to dtype.
+    array = PyArray_NewFromDescr(&PyArray_Type, dtype, 1, &count, NULL,
+        data, NPY_ARRAY_CARRAY, NULL);
+    if (!array)
+    {
+        Py_DECREF(owner);
+        throw pdal_error(getTraceback());
+    }
+    // Steals the reference to owner, even on failure.
+    if (PyArray_SetBaseObject((PyArrayObject *)array, owner) < 0)
+    {
+        Py_DECREF(array);
+        throw pdal_error(getTraceback());
+    }
+    return array;
+}
+
+
+// Accepts either a boolean array with a value for each point ('Mask') or,
+// when 'packed' is set, a uint8 array of bits packed by numpy.packbits()
+// ('PackedMask').
+PointViewPtr Invocation::maskData(PointViewPtr& view, PyObject *maskArray,
+    bool packed)
+{
     PyArrayObject* arr = (PyArrayObject*)maskArray;
+    if (!PyArray_Check(maskArray))
+        throw pdal_error("Mask array must be a numpy array.");
 
-    npy_intp zero = 0;
     PyArray_Descr *dtype = PyArray_DESCR(arr);
 
     npy_intp nDims = PyArray_NDIM(arr);
-    if (nDims != 1 || dtype->kind != 'b')
+    if (packed && (nDims != 1 || dtype->type_num != NPY_UINT8))
+        throw pdal_error("PackedMask array must be a vector of bits packed "
+            "into uint8 values.");
+    if (!packed && (nDims != 1 || dtype->kind != 'b'))
         throw pdal_error("Mask array must be a vector of boolean values.");
 
     npy_intp* shape = PyArray_SHAPE(arr);
     point_count_t arraySize = (point_count_t)*shape;
 
-    if (arraySize != view->size())
+    const point_count_t numPoints = view->size();
+    if (packed && arraySize != (numPoints + 7) / 8)
+        throw pdal_error("Packed mask array must have one bit for each "
+            "point of the input data.");
+    else if (!packed && arraySize != numPoints)
         throw pdal_error("Mask array much be the same length as the input "
             "data.");
 
-    char *p = (char *)PyArray_GetPtr(arr, &zero);
-    point_count_t idx = 0;
-    while (idx < arraySize)
+    PyArrayObject *contig = PyArray_GETCONTIGUOUS(arr);
+    if (!contig)
+        throw pdal_error(getTraceback());
+
+    PointIdList ids;
     {
-        if (*p++)
-            outView->appendPoint(*view, idx);
-        idx++;
+        gil_scoped_release release;
+
+        const char *p = (const char *)PyArray_DATA(contig);
+        ids = packed ?
+            packedMaskIndices((const uint8_t *)p, numPoints) :
+            maskIndices(p, numPoints);
     }
+    Py_DECREF(contig);
+    return selectData(view, ids);
+}
+
+
+// Accepts an array of integer point positions, such as the result of
+// numpy.flatnonzero().  Points are selected in the order given.
+PointViewPtr Invocation::indexData(PointViewPtr& view, PyObject *indexArray)
+{
+    if (!PyArray_Check(indexArray))
+        throw pdal_error("Indices array must be a numpy array.");
+
+    PyArrayObject* arr = (PyArrayObject*)indexArray;
+    if (PyArray_NDIM(arr) != 1 || !PyArray_ISINTEGER(arr))
+        throw pdal_error("Indices array must be a vector of integer "
+            "values.");
+
+    PyArrayObject *ids64 = (PyArrayObject *)PyArray_FROMANY(indexArray,
+        NPY_INT64, 1, 1, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    if (!ids64)
+        throw pdal_error(getTraceback());
+
+    const point_count_t numPoints = view->size();
+    const int64_t *p = (const int64_t *)PyArray_DATA(ids64);
+    const npy_intp count = PyArray_SIZE(ids64);
+
+    PointIdList ids(count);
+    bool ok = true;
+    {
+        gil_scoped_release release;
+
+        for (npy_intp i = 0; i < count; ++i)
+        {
+            ok &= (p[i] >= 0 && (point_count_t)p[i] < numPoints);
+            ids[i] = (PointId)p[i];
+        }
+    }
+    Py_DECREF(ids64);
+    if (!ok)
+        throw pdal_error("Indices array contains values outside the "
+            "range of input points.");
+    return selectData(view, ids);
+}
+
+
+// Accepts an integer label for each point.  Points with the same label
+// are put in the same view.  Points with negative labels are dropped.
+void Invocation::splitData(PointViewPtr& view, PyObject *splitArray,
+    PointViewSet& views, std::vector<int64_t> *used)
+{
+    if (!PyArray_Check(splitArray))
+        throw pdal_error("Split array must be a numpy array.");
+
+    PyArrayObject* arr = (PyArrayObject*)splitArray;
+    if (PyArray_NDIM(arr) != 1 || !PyArray_ISINTEGER(arr))
+        throw pdal_error("Split array must be a vector of integer values.");
+    if ((point_count_t)PyArray_SIZE(arr) != view->size())
+        throw pdal_error("Split array must be the same length as the "
+            "input data.");
+
+    PyArrayObject *labels = (PyArrayObject *)PyArray_FROMANY(splitArray,
+        NPY_INT64, 1, 1, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    if (!labels)
+        throw pdal_error(getTraceback());
+
+    std::vector<PointIdList> lists;
+    {
+        gil_scoped_release release;
+
+        lists = splitIndices((const int64_t *)PyArray_DATA(labels),
+            view->size(), used);
+    }
+    Py_DECREF(labels);
+
+    for (const PointIdList& ids : lists)
+        views.insert(selectData(view, ids));
+}
+
+
+PointViewPtr Invocation::selectData(PointViewPtr& view,
+    const PointIdList& ids)
+{
+    PointViewPtr outView;
+    {
+        std::lock_guard<std::mutex> lock(tableMutex);
+        outView = view->makeNew();
+    }
+
+    gil_scoped_release release;
+
+    for (PointId idx : ids)
+        outView->appendPoint(*view, idx);
     return outView;
 }
 
@@ -449,42 +1014,144 @@ void Invocation::extractData(PointViewPtr& view, PyObject *arrays)
         if (layout->findDim(name) == Dimension::Id::Unknown)
             throw pdal_error("Can't set numpy array '" + name +
                 "' as output.  Dimension not registered.");
+        else if (m_outputDims.size() && !Utils::contains(m_outputDims, name))
+            throw pdal_error("Can't set numpy array '" + name +
+                "' as output.  Dimension not listed as an output "
+                "dimension.");
 
-    Dimension::IdList const& dims = layout->dims();
-    for (auto di = dims.begin(); di != dims.end(); ++di)
+    const size_t pointSize = layout->pointSize();
+    const point_count_t numPoints = view->size();
+    PointRunList runs;
     {
-        Dimension::Id d = *di;
-        const Dimension::Detail *dd = layout->dimDetail(d);
-        std::string name = layout->dimName(*di);
-        if (!Utils::contains(names, name))
-            continue;
-
-        size_t size = dd->size();
-        size_t arrSize(0);
-        PyObject* numpyArray = PyDict_GetItemString(arrays, name.c_str());
-        void *data = extractArray(numpyArray, name, dd->type(), arrSize);
-        char *p = (char *)data;
-        for (PointId idx = 0; idx < arrSize; ++idx)
+        std::lock_guard<std::mutex> lock(tableMutex);
+        runs = findRuns(*view);
+    }
+
+    std::vector<OutputArray> outputs;
+    try
+    {
+        Dimension::IdList const& dims = layout->dims();
+        for (auto di = dims.begin(); di != dims.end(); ++di)
+        {
+            Dimension::Id d = *di;
+            const Dimension::Detail *dd = layout->dimDetail(d);
+            std::string name = layout->dimName(*di);
+            if (!Utils::contains(names, name))
+                continue;
+
+            size_t arrSize(0);
+            PyObject* numpyArray = PyDict_GetItemString(arrays, name.c_str());
+            void *data = extractArray(numpyArray, name, dd->type(), arrSize);
+
+            // An unchanged view of the table was written in place.
+            auto ai = m_aliases.find(name);
+            if (ai != m_aliases.end() && ai->second == data &&
+                arrSize == view->size() &&
+                PyArray_STRIDE((PyArrayObject *)numpyArray, 0) ==
+                    (npy_intp)pointSize)
+                continue;
+
+            // Strided arrays, such as views of the point table, are made
+            // contiguous before they're copied.
+            PyArrayObject *contig =
+                PyArray_GETCONTIGUOUS((PyArrayObject *)numpyArray);
+            if (!contig)
+                throw pdal_error(getTraceback());
+            outputs.push_back({ d, dd, contig, (point_count_t)arrSize });
+        }
+
+        // Arrays longer than the view add points.  Dimensions of new
+        // points that no array sets are zero.
+        point_count_t count = numPoints;
+        for (const OutputArray& o : outputs)
+            count = (std::max)(count, o.m_count);
+        if (count > numPoints)
+        {
+            std::lock_guard<std::mutex> lock(tableMutex);
+            appendPoints(*view, count - numPoints);
+            runs = findRuns(*view);
+        }
+
+        gil_scoped_release release;
+
+        // Values are written in parallel.
+        std::vector<std::function<void()>> tasks;
+        RunSliceList slices = splitRuns(runs, pointSize, m_numThreads,
+            MinSlicePoints);
+        for (const OutputArray& o : outputs)
+        {
+            const size_t offset = o.m_detail->offset();
+            const size_t size = o.m_detail->size();
+            const char *src = (const char *)PyArray_DATA(o.m_array);
+            for (const RunSlice& s : slices)
+            {
+                if (s.m_start >= o.m_count)
+                    break;
+                const RunSlice *slice = &s;
+                point_count_t n = (std::min)(o.m_count - s.m_start,
+                    s.m_count);
+                tasks.push_back([=]()
+                {
+                    scatterDim(slice->m_runs, pointSize, offset, size,
+                        src + slice->m_start * size, n);
+                });
+            }
+        }
+        runTasks(tasks);
+
+        // Tables that don't store points by row are set a field at a
+        // time.
+        for (const OutputArray& o : outputs)
         {
-            view->setField(d, dd->type(), idx, (void *)p);
-            p += size;
+            const Dimension::Detail *dd = o.m_detail;
+            PointId idx = runs.size() ? o.m_count : 0;
+            char *p = (char *)PyArray_DATA(o.m_array) + idx * dd->size();
+            for (; idx < o.m_count; ++idx)
+            {
+                view->setField(o.m_id, dd->type(), idx, (void *)p);
+                p += dd->size();
+            }
         }
     }
+    catch (...)
+    {
+        for (OutputArray& o : outputs)
+            Py_DECREF(o.m_array);
+        throw;
+    }
+    for (OutputArray& o : outputs)
+        Py_DECREF(o.m_array);
 
-    // Clean up the input buffers.
-    for (void *b : m_numpyBuffers)
-        free(b);
-    m_numpyBuffers.clear();
+    m_aliases.clear();
 }
 
 
-void Invocation::extractMetadata(MetadataNode stageMetadata)
+// Drops the references to input arrays that view point table memory.
+// The table's points may move or be freed once the call is done, so
+// arrays the script still holds are given copies of their data.
+void Invocation::releaseAliases()
 {
-    PyObject *key = PyUnicode_FromString("out_metadata");
-    PyObject *dictionary = PyModule_GetDict(m_module);
-    PyObject *pyMeta = PyDict_GetItem(dictionary, key);
-    addMetadata(pyMeta, stageMetadata);
-    Py_DECREF(key);
+    gil_scoped_acquire acquire;
+
+    for (PyObject *array : m_aliasArrays)
+    {
+        if (Py_REFCNT(array) > 1 && !detachAlias((PyArrayObject *)array))
+        {
+            // Failing that, the data can at least not be written.
+            PyErr_Clear();
+            PyArray_CLEARFLAGS((PyArrayObject *)array, NPY_ARRAY_WRITEABLE);
+        }
+        Py_DECREF(array);
+    }
+    m_aliasArrays.clear();
+}
+
+
+// Adds the 'out_metadata' read after the call to the stage's metadata.
+void Invocation::extractMetadata(MetadataNode stageMetadata,
+    PyObject *outMetadata)
+{
+    addMetadata(outMetadata, stageMetadata);
 }
 
 } // namespace plang
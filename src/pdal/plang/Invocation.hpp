@@ -38,9 +38,18 @@
 
 #include "Script.hpp"
 #include "Environment.hpp"
+#include "BufferPool.hpp"
+#include "Marshal.hpp"
 
 #include <pdal/Dimension.hpp>
 #include <pdal/PointView.hpp>
+#include <pdal/SpatialReference.hpp>
+#include <pdal/util/ThreadPool.hpp>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
 
 // PDAL renamed this but it is not aliased on windows for PDAL 2.9
 #   define PDAL_DLL     PDAL_EXPORT
@@ -53,38 +62,132 @@ namespace plang
 class PDAL_DLL Invocation
 {
 public:
-    Invocation(const Script&, MetadataNode m, const std::string& pdalArgs);
+    // If 'cacheDir' isn't empty, compiled code is cached in that
+    // directory.  See compileScript().  The module is shared with other
+    // invocations of the same script unless 'isolated' is set, in which
+    // case it has globals of its own.  See loadModule().
+    Invocation(const Script&, MetadataNode m, const std::string& pdalArgs,
+        const std::string& cacheDir = "", bool isolated = false);
     Invocation& operator=(Invocation const& rhs) = delete;
     Invocation(const Invocation& other) = delete;
-    ~Invocation()
-    {}
+    ~Invocation();
 
     bool execute(PointViewPtr& v, MetadataNode stageMetadata);
 
+    // As above, but 'views' gets a view for each label if the function
+    // sets outs['Split'].  Otherwise it gets the resulting view.  If
+    // 'labels' isn't null, it's set to the label of each view added by
+    // a split, in the order the views were made, and is otherwise empty.
+    bool execute(PointViewPtr& v, MetadataNode stageMetadata,
+        PointViewSet& views, std::vector<int64_t> *labels = nullptr);
+
+    // When set, views whose points are contiguous in a row-oriented
+    // point table are passed to the script as numpy arrays that alias
+    // the table memory.  Changes made in place to the 'ins' arrays are
+    // then written straight into the points.
+    void setZeroCopy(bool zeroCopy)
+        { m_zeroCopy = zeroCopy; }
+
+    // When set, 'ins' is a single structured array with a field for
+    // each dimension instead of a mapping of arrays.  Field offsets match
+    // the point layout.
+    void setStructured(bool structured)
+        { m_structured = structured; }
+
+    // Number of threads used to copy point data to and from arrays.
+    // Python isn't locked while data is copied.
+    void setThreads(size_t numThreads);
+
+    // Called in a child process after fork().  The marshaling threads
+    // weren't copied, so the calling thread does all the work.
+    void afterFork();
+
+    // When set, large input array buffers are backed by huge pages
+    // where the platform supports it.
+    void setHugePages(bool hugePages)
+        { m_pool.reset(new BufferPool(hugePages)); }
+
+    // Limits the arrays passed in 'ins' to the named dimensions.  All
+    // dimensions are passed if the list is empty.
+    void setInputDims(const StringList& dims)
+        { m_inputDims = dims; }
+
+    // Limits the arrays accepted from 'outs' to the named dimensions.  Any
+    // registered dimension is accepted if the list is empty.
+    void setOutputDims(const StringList& dims)
+        { m_outputDims = dims; }
+
+    // The function to call.  A reference is held, since another
+    // invocation of the same module may replace it in the module.
     PyObject* m_function;
 
 private:
-    void compile();
+    void compile(const std::string& cacheDir, bool isolated);
     PyObject *prepareData(PointViewPtr& view);
+    PyObject *loadArray(PointView& view, const std::string& name);
+    PyObject *loadRecords(PointView& view, const StringList& names);
+    void updatePlan(PointView& view);
+    void runTasks(std::vector<std::function<void()>>& tasks);
     void extractData(PointViewPtr& view, PyObject *outArrays);
-    PyObject *addArray(std::string const& name, uint8_t* data,
-        Dimension::Type t, point_count_t count);
+    PyObject *addArray(uint8_t* data, Dimension::Type t,
+        point_count_t count);
+    PyObject *aliasArray(uint8_t* data, Dimension::Type t,
+        point_count_t count, size_t stride);
     void *extractArray(PyObject *array, const std::string& name,
         Dimension::Type dataType, size_t& arrSize);
-    PointViewPtr maskData(PointViewPtr& view, PyObject *maskArray);
-    void extractMetadata(MetadataNode stageMetadata);
+    PointViewPtr maskData(PointViewPtr& view, PyObject *maskArray,
+        bool packed);
+    PointViewPtr indexData(PointViewPtr& view, PyObject *indexArray);
+    void splitData(PointViewPtr& view, PyObject *splitArray,
+        PointViewSet& views, std::vector<int64_t> *used);
+    PointViewPtr selectData(PointViewPtr& view, const PointIdList& ids);
+    void extractMetadata(MetadataNode stageMetadata,
+        PyObject *outMetadata);
+    void releaseAliases();
 
     Script m_script;
 
     PyObject* m_module;
-    // Pointer to the function in the module.  Owned by the module.
-
-    // Pointers to numpy arrays and contained data buffers for cleanup.
-    std::vector<PyObject*> m_pyInputArrays;
-    std::vector<void *> m_numpyBuffers;
+    int m_numArgs;
+
+    // Buffers for input arrays.  Arrays keep the pool alive, so a
+    // script can hold on to them after the invocation is gone.
+    BufferPoolPtr m_pool;
+    // Runs of consecutive points in the view being processed.
+    PointRunList m_runs;
+    // Whether input arrays alias point table memory, and their data
+    // pointers.
+    bool m_aliased;
+    std::map<std::string, uint8_t *> m_aliases;
+    // The arrays that alias the table.  Each holds a reference.
+    std::vector<PyObject *> m_aliasArrays;
+
+    // Python objects that only need rebuilding when the layout or
+    // spatial reference of the views changes.
+    struct CallPlan
+    {
+        CallPlan() : m_layout(nullptr), m_keys(nullptr),
+            m_pdalargs(nullptr), m_schema(nullptr), m_srs(nullptr)
+        {}
+
+        PointLayoutPtr m_layout;
+        Dimension::IdList m_dims;
+        StringList m_names;
+        PyObject *m_keys;       // Interned names of the input arrays.
+        PyObject *m_pdalargs;
+        PyObject *m_schema;
+        SpatialReference m_srsValue;
+        PyObject *m_srs;
+    } m_plan;
 
     MetadataNode m_inputMetadata;
     std::string m_pdalargs;
+    bool m_zeroCopy;
+    bool m_structured;
+    size_t m_numThreads;
+    std::unique_ptr<ThreadPool> m_workers;
+    StringList m_inputDims;
+    StringList m_outputDims;
 };
 
 } // namespace plang
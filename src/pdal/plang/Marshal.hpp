@@ -0,0 +1,126 @@
+/******************************************************************************
+* Copyright (c) 2026, Hobu Inc. (info@hobu.co)
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following
+* conditions are met:
+*
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in
+*       the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of Hobu, Inc. or Flaxen Geo Consulting nor the
+*       names of its contributors may be used to endorse or promote
+*       products derived from this software without specific prior
+*       written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+* COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+* OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+* AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+* OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+* OF SUCH DAMAGE.
+****************************************************************************/
+
+#pragma once
+
+#include <pdal/pdal_internal.hpp>
+#include <pdal/PointView.hpp>
+#include <pdal/util/ThreadPool.hpp>
+
+#include <functional>
+#include <vector>
+
+// PDAL renamed this but it is not aliased on windows for PDAL 2.9
+#   define PDAL_DLL     PDAL_EXPORT
+
+namespace pdal
+{
+namespace plang
+{
+
+// A run of points stored back to back in row-oriented table memory.
+struct PointRun
+{
+    char *m_base;
+    point_count_t m_count;
+};
+typedef std::vector<PointRun> PointRunList;
+
+// A share of a run list, starting at point 'm_start' of the view.
+struct RunSlice
+{
+    PointRunList m_runs;
+    point_count_t m_start;
+    point_count_t m_count;
+};
+typedef std::vector<RunSlice> RunSliceList;
+
+// Breaks a view into runs of consecutive points.  Returns an empty list if
+// the view is empty or its table doesn't store points by row.
+PDAL_DLL PointRunList findRuns(PointView& view);
+
+// Breaks the points from 'begin' up to 'end' of a view into runs.
+PDAL_DLL PointRunList findRuns(PointView& view, PointId begin, PointId end);
+
+// Adds 'count' points to the end of a view with every dimension set to
+// zero.
+PDAL_DLL void appendPoints(PointView& view, point_count_t count);
+
+// Splits runs into at most 'parts' slices of about the same number of
+// points.  Every slice but the last has at least 'minPoints' points.
+// Runs may be split across slices.
+PDAL_DLL RunSliceList splitRuns(const PointRunList& runs, size_t pointSize,
+    size_t parts, point_count_t minPoints);
+
+// Runs tasks on the pool's threads and waits for them, rethrowing the
+// first exception thrown.  With no pool or a single task they're run on
+// this thread.  The tasks must not touch Python objects.
+PDAL_DLL void runTasks(ThreadPool *pool,
+    std::vector<std::function<void()>>& tasks);
+
+// Copies the dimension at 'offset' in each point of the runs into the
+// packed buffer 'dst'.
+PDAL_DLL void gatherDim(const PointRunList& runs, size_t pointSize,
+    size_t offset, size_t dimSize, char *dst);
+
+// Copies up to 'count' packed values from 'src' into the dimension at
+// 'offset' in each point of the runs.
+PDAL_DLL void scatterDim(const PointRunList& runs, size_t pointSize,
+    size_t offset, size_t dimSize, const char *src, point_count_t count);
+
+// As above, but the values are 'srcStride' bytes apart in 'src'.  If 'swap'
+// is set, the bytes of each value are reversed.
+PDAL_DLL void scatterDim(const PointRunList& runs, size_t pointSize,
+    size_t offset, size_t dimSize, const char *src, size_t srcStride,
+    point_count_t count, bool swap);
+
+// Returns the positions of the non-zero bytes in a mask of 'count'
+// bytes.
+PDAL_DLL PointIdList maskIndices(const char *mask, point_count_t count);
+
+// Returns the positions of the set bits in a mask of 'count' bits packed
+// most significant bit first, as numpy.packbits() does by default.
+PDAL_DLL PointIdList packedMaskIndices(const uint8_t *bits,
+    point_count_t count);
+
+// Groups positions by label with a counting sort.  Returns a list of
+// positions for each distinct label, in ascending order of label.
+// Positions with negative labels are left out.  If 'used' isn't null,
+// it's set to the label of each list.
+PDAL_DLL std::vector<PointIdList> splitIndices(const int64_t *labels,
+    point_count_t count, std::vector<int64_t> *used = nullptr);
+
+} // namespace plang
+} // namespace pdal
+
@@ -0,0 +1,393 @@
+/******************************************************************************
+* Copyright (c) 2026, Hobu Inc. (info@hobu.co)
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following
+* conditions are met:
+*
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in
+*       the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of Hobu, Inc. or Flaxen Geo Consulting nor the
+*       names of its contributors may be used to endorse or promote
+*       products derived from this software without specific prior
+*       written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+* COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+* OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+* AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+* OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+* OF SUCH DAMAGE.
+****************************************************************************/
+
+#include "MetadataDict.hpp"
+#include "gil.hpp"
+
+#include <exception>
+#include <mutex>
+
+namespace pdal
+{
+namespace plang
+{
+
+namespace
+{
+
+// A dict subclass, so that scripts and json.dumps() treat it as the
+// plain dict they used to get.
+struct MetadataDict
+{
+    PyDictObject dict;
+    MetadataNode *node;     // Null once 'children' has been added.
+};
+
+PyTypeObject MetadataDictType;
+
+PyObject *newNode(MetadataNode m);
+
+
+// Adds the 'children' entry if it hasn't been added yet.
+// Returns 0 on success, -1 with a Python exception set on failure.
+int expand(PyObject *self)
+{
+    MetadataDict *d = reinterpret_cast<MetadataDict *>(self);
+    if (!d->node)
+        return 0;
+
+    MetadataNodeList children;
+    try
+    {
+        children = d->node->children();
+    }
+    catch (const std::exception& err)
+    {
+        PyErr_SetString(PyExc_RuntimeError, err.what());
+        return -1;
+    }
+    delete d->node;
+    d->node = nullptr;
+    if (children.empty())
+        return 0;
+
+    PyObject *list = PyList_New(0);
+    if (!list)
+        return -1;
+    for (MetadataNode& child : children)
+    {
+        PyObject *c = newNode(child);
+        if (!c || PyList_Append(list, c))
+        {
+            Py_XDECREF(c);
+            Py_DECREF(list);
+            return -1;
+        }
+        Py_DECREF(c);
+    }
+    int result = PyDict_SetItemString(self, "children", list);
+    Py_DECREF(list);
+    return result;
+}
+
+
+void MetadataDict_dealloc(PyObject *self)
+{
+    MetadataDict *d = reinterpret_cast<MetadataDict *>(self);
+    delete d->node;
+    d->node = nullptr;
+    PyDict_Type.tp_dealloc(self);
+}
+
+
+// Only a missing key can be affected by expanding, so a lookup of one of
+// the node's own fields leaves the children alone.
+PyObject *MetadataDict_subscript(PyObject *self, PyObject *key)
+{
+    PyObject *value = PyDict_GetItemWithError(self, key);
+    if (!value && !PyErr_Occurred())
+    {
+        if (expand(self))
+            return nullptr;
+        value = PyDict_GetItemWithError(self, key);
+    }
+    if (!value)
+    {
+        if (!PyErr_Occurred())
+            PyErr_SetObject(PyExc_KeyError, key);
+        return nullptr;
+    }
+    Py_INCREF(value);
+    return value;
+}
+
+
+int MetadataDict_ass_subscript(PyObject *self, PyObject *key,
+    PyObject *value)
+{
+    if (expand(self))
+        return -1;
+    return PyDict_Type.tp_as_mapping->mp_ass_subscript(self, key, value);
+}
+
+
+Py_ssize_t MetadataDict_length(PyObject *self)
+{
+    if (expand(self))
+        return -1;
+    return PyDict_Size(self);
+}
+
+
+int MetadataDict_contains(PyObject *self, PyObject *key)
+{
+    if (expand(self))
+        return -1;
+    return PyDict_Contains(self, key);
+}
+
+
+PyObject *MetadataDict_iter(PyObject *self)
+{
+    if (expand(self))
+        return nullptr;
+    return PyDict_Type.tp_iter(self);
+}
+
+
+PyObject *MetadataDict_repr(PyObject *self)
+{
+    if (expand(self))
+        return nullptr;
+    return PyDict_Type.tp_repr(self);
+}
+
+
+PyObject *MetadataDict_richcompare(PyObject *self, PyObject *other, int op)
+{
+    if (expand(self))
+        return nullptr;
+    if (PyObject_TypeCheck(other, &MetadataDictType) && expand(other))
+        return nullptr;
+    return PyDict_Type.tp_richcompare(self, other, op);
+}
+
+
+// Calls the dict method 'name' once the children have been added.
+PyObject *callDictMethod(const char *name, PyObject *self, PyObject *args,
+    PyObject *kwargs)
+{
+    if (expand(self))
+        return nullptr;
+
+    PyObject *method = PyObject_GetAttrString(
+        reinterpret_cast<PyObject *>(&PyDict_Type), name);
+    if (!method)
+        return nullptr;
+
+    Py_ssize_t size = args ? PyTuple_GET_SIZE(args) : 0;
+    PyObject *allArgs = PyTuple_New(size + 1);
+    if (!allArgs)
+    {
+        Py_DECREF(method);
+        return nullptr;
+    }
+    Py_INCREF(self);
+    PyTuple_SET_ITEM(allArgs, 0, self);
+    for (Py_ssize_t i = 0; i < size; ++i)
+    {
+        PyObject *arg = PyTuple_GET_ITEM(args, i);
+        Py_INCREF(arg);
+        PyTuple_SET_ITEM(allArgs, i + 1, arg);
+    }
+    PyObject *result = PyObject_Call(method, allArgs, kwargs);
+    Py_DECREF(allArgs);
+    Py_DECREF(method);
+    return result;
+}
+
+
+PyObject *MetadataDict_keys(PyObject *self, PyObject *args)
+{
+    return callDictMethod("keys", self, args, nullptr);
+}
+
+
+PyObject *MetadataDict_values(PyObject *self, PyObject *args)
+{
+    return callDictMethod("values", self, args, nullptr);
+}
+
+
+PyObject *MetadataDict_items(PyObject *self, PyObject *args)
+{
+    return callDictMethod("items", self, args, nullptr);
+}
+
+
+PyObject *MetadataDict_get(PyObject *self, PyObject *args)
+{
+    return callDictMethod("get", self, args, nullptr);
+}
+
+
+PyObject *MetadataDict_copy(PyObject *self, PyObject *args)
+{
+    return callDictMethod("copy", self, args, nullptr);
+}
+
+
+PyObject *MetadataDict_pop(PyObject *self, PyObject *args)
+{
+    return callDictMethod("pop", self, args, nullptr);
+}
+
+
+PyObject *MetadataDict_popitem(PyObject *self, PyObject *args)
+{
+    return callDictMethod("popitem", self, args, nullptr);
+}
+
+
+PyObject *MetadataDict_setdefault(PyObject *self, PyObject *args)
+{
+    return callDictMethod("setdefault", self, args, nullptr);
+}
+
+
+PyObject *MetadataDict_update(PyObject *self, PyObject *args,
+    PyObject *kwargs)
+{
+    return callDictMethod("update", self, args, kwargs);
+}
+
+
+PyMappingMethods MetadataDict_mapping =
+{
+    MetadataDict_length,        /* mp_length */
+    MetadataDict_subscript,     /* mp_subscript */
+    MetadataDict_ass_subscript  /* mp_ass_subscript */
+};
+
+
+PySequenceMethods MetadataDict_sequence = {};
+
+
+PyMethodDef MetadataDict_methods[] =
+{
+    {"keys", MetadataDict_keys, METH_NOARGS, "dict.keys"},
+    {"values", MetadataDict_values, METH_NOARGS, "dict.values"},
+    {"items", MetadataDict_items, METH_NOARGS, "dict.items"},
+    {"get", MetadataDict_get, METH_VARARGS, "dict.get"},
+    {"copy", MetadataDict_copy, METH_NOARGS, "dict.copy"},
+    {"pop", MetadataDict_pop, METH_VARARGS, "dict.pop"},
+    {"popitem", MetadataDict_popitem, METH_NOARGS, "dict.popitem"},
+    {"setdefault", MetadataDict_setdefault, METH_VARARGS,
+        "dict.setdefault"},
+    {"update", (PyCFunction)(void(*)(void))MetadataDict_update,
+        METH_VARARGS | METH_KEYWORDS, "dict.update"},
+    {0, 0, 0, 0} // sentinel
+};
+
+
+bool initType()
+{
+    // Free-threaded builds can get here from several threads at once.
+    static std::mutex mutex;
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (MetadataDictType.tp_name)
+        return true;
+
+    MetadataDict_sequence.sq_contains = MetadataDict_contains;
+
+    MetadataDictType.tp_name = "plang.MetadataDict";
+    MetadataDictType.tp_basicsize = sizeof(MetadataDict);
+    MetadataDictType.tp_dealloc = MetadataDict_dealloc;
+    MetadataDictType.tp_repr = MetadataDict_repr;
+    MetadataDictType.tp_as_sequence = &MetadataDict_sequence;
+    MetadataDictType.tp_as_mapping = &MetadataDict_mapping;
+    MetadataDictType.tp_flags = Py_TPFLAGS_DEFAULT;
+    MetadataDictType.tp_doc = "PDAL metadata node, converted on first "
+        "access";
+    MetadataDictType.tp_richcompare = MetadataDict_richcompare;
+    MetadataDictType.tp_iter = MetadataDict_iter;
+    MetadataDictType.tp_methods = MetadataDict_methods;
+    MetadataDictType.tp_base = &PyDict_Type;
+    if (PyType_Ready(&MetadataDictType) < 0)
+    {
+        MetadataDictType.tp_name = nullptr;
+        return false;
+    }
+    return true;
+}
+
+
+PyObject *newString(const std::string& s)
+{
+    PyObject *o = PyUnicode_FromStringAndSize(s.data(), s.size());
+    if (!o)
+    {
+        PyErr_Clear();
+        o = PyUnicode_FromString("<INVALID UNICODE>");
+    }
+    return o;
+}
+
+
+// Returns a new reference, or nullptr with a Python exception set.
+PyObject *newNode(MetadataNode m)
+{
+    PyObject *self = PyObject_CallObject(
+        reinterpret_cast<PyObject *>(&MetadataDictType), nullptr);
+    if (!self)
+        return nullptr;
+
+    const char *fields[] = { "name", "value", "type", "description" };
+    const std::string values[] =
+        { m.name(), m.value(), m.type(), m.description() };
+    for (size_t i = 0; i < 4; ++i)
+    {
+        PyObject *value = newString(values[i]);
+        if (!value || PyDict_SetItemString(self, fields[i], value))
+        {
+            Py_XDECREF(value);
+            Py_DECREF(self);
+            return nullptr;
+        }
+        Py_DECREF(value);
+    }
+    reinterpret_cast<MetadataDict *>(self)->node = new MetadataNode(m);
+    return self;
+}
+
+} // unnamed namespace
+
+
+PyObject *newMetadataDict(MetadataNode m)
+{
+    gil_scoped_acquire acquire;
+
+    if (!initType())
+        throw pdal_error("Unable to create the metadata dictionary type.");
+
+    PyObject *dict = newNode(m);
+    if (!dict)
+        throw pdal_error("Unable to create a metadata dictionary.");
+    return dict;
+}
+
+} // namespace plang
+} // namespace pdal
+
@@ -0,0 +1,120 @@
+/******************************************************************************
+* Copyright (c) 2026, Hobu Inc. (info@hobu.co)
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following
+* conditions are met:
+*
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in
+*       the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of Hobu, Inc. or Flaxen Geo Consulting nor the
+*       names of its contributors may be used to endorse or promote
+*       products derived from this software without specific prior
+*       written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+* COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+* OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+* AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+* OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+* OF SUCH DAMAGE.
+****************************************************************************/
+
+#include "ModuleRegistry.hpp"
+#include "CodeCache.hpp"
+#include "Environment.hpp"
+
+#include <map>
+#include <mutex>
+#include <utility>
+
+namespace pdal
+{
+namespace plang
+{
+
+namespace
+{
+
+typedef std::pair<std::string, std::string> ModuleKey;
+
+// Keyed by source and module name.  Modules live as long as the process.
+// The mutex is only held to look up and add entries, not while module
+// code runs, since that code may wait on other threads.
+std::map<ModuleKey, PyObject *> registry;
+std::mutex registryMutex;
+
+// Returns a new reference to a new module that has run the source.
+PyObject *execModule(const Script& script, const std::string& cacheDir)
+{
+    PyObject *code = compileScript(script, cacheDir);
+
+    // PyImport_ExecCodeModule reruns the code in a module of the same
+    // name if there is one, so any such module is removed first.
+    PyObject *modules = PyImport_GetModuleDict();
+    if (PyDict_DelItemString(modules, script.module()))
+        PyErr_Clear();
+
+    PyObject *module = PyImport_ExecCodeModule(
+        const_cast<char *>(script.module()), code);
+    Py_DECREF(code);
+    if (!module)
+        throw pdal_error(getTraceback());
+    return module;
+}
+
+} // unnamed namespace
+
+
+PyObject *loadModule(const Script& script, const std::string& cacheDir,
+    bool isolated)
+{
+    if (isolated)
+        return execModule(script, cacheDir);
+
+    const ModuleKey key(script.source(), script.module());
+    PyObject *module(nullptr);
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        auto it = registry.find(key);
+        if (it != registry.end())
+            module = it->second;
+    }
+
+    if (!module)
+    {
+        PyObject *loaded = execModule(script, cacheDir);
+
+        // If another thread loaded the same module meanwhile, theirs is
+        // used so that everyone shares one.
+        std::lock_guard<std::mutex> lock(registryMutex);
+        auto result = registry.insert(std::make_pair(key, loaded));
+        if (!result.second)
+            Py_DECREF(loaded);
+        module = result.first->second;
+    }
+
+    // A module of the same name with other source may have been loaded
+    // since, and code that finds the module by name (pickle, for one)
+    // should get this one.
+    if (PyDict_SetItemString(PyImport_GetModuleDict(), script.module(),
+            module))
+        PyErr_Clear();
+    Py_INCREF(module);
+    return module;
+}
+
+} // namespace plang
+} // namespace pdal
@@ -0,0 +1,629 @@
+/******************************************************************************
+* Copyright (c) 2026, Hobu Inc. (info@hobu.co)
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following
+* conditions are met:
+*
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in
+*       the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of Hobu, Inc. or Flaxen Geo Consulting nor the
+*       names of its contributors may be used to endorse or promote
+*       products derived from this software without specific prior
+*       written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+* COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+* OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+* AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+* OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+* OF SUCH DAMAGE.
+****************************************************************************/
+
+#include "ProcessRunner.hpp"
+#include "Environment.hpp"
+#include "gil.hpp"
+
+#include <pdal/PointTable.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+
+#ifndef _WIN32
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace pdal
+{
+namespace plang
+{
+
+#ifndef _WIN32
+
+namespace
+{
+
+// The points of one slice, stored by row with the layout of the table
+// that they come from, so that rows can be copied whole.  The buffer is
+// reused for each slice.
+class SliceTable : public SimplePointTable
+{
+public:
+    SliceTable(PointLayout& layout) :
+        SimplePointTable(layout), m_pointSize(layout.pointSize()),
+        m_capacity(0), m_numPoints(0)
+    {}
+
+    // Makes room for the rows of 'count' points, to be read into the
+    // buffer returned.
+    char *reset(point_count_t count)
+    {
+        m_rows.resize((std::max)(count * m_pointSize, (size_t)1));
+        m_capacity = count;
+        m_numPoints = 0;
+        return m_rows.data();
+    }
+
+    // Makes a view of the points whose rows were read.
+    PointViewPtr makeView()
+    {
+        PointViewPtr view(new PointView(*this));
+        const Dimension::Id first = layout()->dims().front();
+        const Dimension::Detail *dd = layout()->dimDetail(first);
+        char buf[sizeof(double)];   // Large enough for any dimension.
+        for (PointId id = 0; id < m_capacity; ++id)
+        {
+            // Setting a field of the point past the end adds a point.
+            // The value set is the one that's there.
+            std::memcpy(buf, getPoint(id) + dd->offset(), dd->size());
+            view->setField(first, dd->type(), id, buf);
+        }
+        return view;
+    }
+
+    virtual bool supportsView() const
+        { return true; }
+    virtual char *getPoint(PointId idx)
+        { return m_rows.data() + idx * m_pointSize; }
+
+    // The ID of the point whose data is at 'p'.
+    PointId pointId(const char *p) const
+        { return (PointId)((p - m_rows.data()) / m_pointSize); }
+
+protected:
+    virtual PointId addPoint()
+    {
+        if (m_numPoints == m_capacity)
+            throw pdal_error("Can't add points when running in more "
+                "than one process.");
+        return m_numPoints++;
+    }
+
+private:
+    size_t m_pointSize;
+    point_count_t m_capacity;
+    point_count_t m_numPoints;
+    std::vector<char> m_rows;
+};
+
+
+// The parent's ends of the sockets to all worker processes.  A worker
+// stops when every copy of its socket is closed, so a child closes the
+// ones it inherits.
+std::mutex socketsMutex;
+std::set<int> parentSockets;
+
+#ifdef MSG_NOSIGNAL
+const int SendFlags = MSG_NOSIGNAL;
+#else
+const int SendFlags = 0;    // SO_NOSIGPIPE is set on the socket instead.
+#endif
+
+
+// Returns false if the other end has gone away.
+bool sendAll(int fd, const void *data, size_t size)
+{
+    const char *p = (const char *)data;
+    while (size)
+    {
+        ssize_t n = send(fd, p, size, SendFlags);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+
+// Returns false if the other end has gone away before 'size' bytes were
+// read.
+bool recvAll(int fd, void *data, size_t size)
+{
+    char *p = (char *)data;
+    while (size)
+    {
+        ssize_t n = read(fd, p, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+
+bool recvString(int fd, std::string& s)
+{
+    uint64_t size;
+    if (!recvAll(fd, &size, sizeof(size)))
+        return false;
+    s.resize(size);
+    return recvAll(fd, &s[0], size);
+}
+
+
+// Calls pickle.'func'(arg).  Returns a new reference.
+PyObject *callPickle(const char *func, PyObject *arg)
+{
+    PyObject *pickle = PyImport_ImportModule("pickle");
+    if (!pickle)
+        throw pdal_error(getTraceback());
+    PyObject *result = PyObject_CallMethod(pickle, func, "O", arg);
+    Py_DECREF(pickle);
+    if (!result)
+        throw pdal_error(getTraceback());
+    return result;
+}
+
+
+// Adds a node made by fromMetadata() to 'parent'.
+void addNode(PyObject *dict, MetadataNode parent)
+{
+    auto str = [dict](const char *key)
+    {
+        PyObject *o = PyDict_GetItemString(dict, key);
+        const char *s = o ? PyUnicode_AsUTF8(o) : nullptr;
+        return std::string(s ? s : "");
+    };
+
+    MetadataNode node = parent.addWithType(str("name"), str("value"),
+        str("type"), str("description"));
+    PyObject *children = PyDict_GetItemString(dict, "children");
+    if (children)
+        for (Py_ssize_t i = 0; i < PyList_Size(children); ++i)
+            addNode(PyList_GetItem(children, i), node);
+}
+
+} // unnamed namespace
+
+
+// Worker processes, forked the first time they're needed.  Each is sent
+// slices over its socket and replies with the results.
+struct ProcessRunner::Pool
+{
+    struct Worker
+    {
+        pid_t m_pid;
+        int m_socket;
+    };
+
+    ~Pool()
+    {
+        for (Worker& w : m_workers)
+        {
+            {
+                std::lock_guard<std::mutex> lock(socketsMutex);
+                parentSockets.erase(w.m_socket);
+            }
+            close(w.m_socket);
+        }
+        for (Worker& w : m_workers)
+        {
+            int status;
+            while (waitpid(w.m_pid, &status, 0) < 0 && errno == EINTR)
+                ;
+        }
+    }
+
+    PointLayoutPtr m_layout;
+    size_t m_pointSize;
+    std::vector<Worker> m_workers;
+};
+
+
+ProcessRunner::ProcessRunner(Invocation& method, size_t numProcesses) :
+    m_method(method), m_numProcesses((std::max)(numProcesses, (size_t)1))
+{}
+
+
+ProcessRunner::~ProcessRunner()
+{}
+
+
+// Forks the workers.  They're copies of this process, so they have the
+// compiled script and the table's layout.
+void ProcessRunner::startPool(PointLayoutPtr layout)
+{
+    m_pool.reset(new Pool);
+    m_pool->m_layout = layout;
+    m_pool->m_pointSize = layout->pointSize();
+
+    // Held across fork(), so the set a child sees is complete.
+    std::lock_guard<std::mutex> lock(socketsMutex);
+    for (size_t i = 0; i < m_numProcesses; ++i)
+    {
+        int fd[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fd))
+            throw pdal_error("Unable to start a worker process: " +
+                std::string(std::strerror(errno)));
+#ifdef SO_NOSIGPIPE
+        int on = 1;
+        setsockopt(fd[0], SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+        setsockopt(fd[1], SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+        PyOS_BeforeFork();
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            PyOS_AfterFork_Child();
+            close(fd[0]);
+            for (int s : parentSockets)
+                close(s);
+            m_method.afterFork();
+            serve(fd[1], *layout);
+            // Nothing in the child may clean up the parent's state.
+            _exit(0);
+        }
+        PyOS_AfterFork_Parent();
+        close(fd[1]);
+        if (pid < 0)
+        {
+            int err = errno;
+            close(fd[0]);
+            throw pdal_error("Unable to start a worker process: " +
+                std::string(std::strerror(err)));
+        }
+        parentSockets.insert(fd[0]);
+        m_pool->m_workers.push_back({ pid, fd[0] });
+    }
+}
+
+
+// Runs in a worker.  Each request is a point count followed by the rows
+// of the points.  The reply is a status byte and, on failure, a message.
+// Otherwise it's whether the slice was split, the rows as the function
+// left them, the label of each point (-1 if it was dropped) and the
+// pickled metadata that the function added.  Returns when the parent
+// closes the socket.
+void ProcessRunner::serve(int fd, PointLayout& layout)
+{
+    SliceTable table(layout);
+    const size_t pointSize = layout.pointSize();
+    while (true)
+    {
+        uint64_t count;
+        if (!recvAll(fd, &count, sizeof(count)))
+            return;
+        char *rows = table.reset(count);
+        if (!recvAll(fd, rows, count * pointSize))
+            return;
+
+        std::string reply(1, 0);
+        try
+        {
+            MetadataNode metadata("metadata");
+            PointViewPtr view = table.makeView();
+            PointViewSet views;
+            std::vector<int64_t> viewLabels;
+            m_method.execute(view, metadata, views, &viewLabels);
+
+            std::vector<int64_t> labels(count, -1);
+            const bool split = viewLabels.size() || views.size() != 1;
+            if (!split)
+            {
+                PointViewPtr result = *views.begin();
+                PointId last = 0;
+                for (PointId idx = 0; idx < result->size(); ++idx)
+                {
+                    PointId id = table.pointId(result->getPoint(idx));
+                    if (idx && id <= last)
+                        throw pdal_error("'Indices' output must be in "
+                            "increasing order when running in more "
+                            "than one process.");
+                    labels[id] = 0;
+                    last = id;
+                }
+            }
+            else
+            {
+                auto label = viewLabels.begin();
+                for (const PointViewPtr& result : views)
+                {
+                    for (PointId idx = 0; idx < result->size(); ++idx)
+                        labels[table.pointId(result->getPoint(idx))] =
+                            *label;
+                    ++label;
+                }
+            }
+
+            PyObject *list = PyList_New(0);
+            for (MetadataNode& child : metadata.children())
+            {
+                PyObject *node = fromMetadata(child);
+                PyList_Append(list, node);
+                Py_DECREF(node);
+            }
+            PyObject *bytes = callPickle("dumps", list);
+            Py_DECREF(list);
+            std::string pickled(PyBytes_AS_STRING(bytes),
+                PyBytes_GET_SIZE(bytes));
+            Py_DECREF(bytes);
+
+            reply.push_back(split);
+            reply.append(rows, count * pointSize);
+            reply.append((const char *)labels.data(),
+                count * sizeof(int64_t));
+            uint64_t size = pickled.size();
+            reply.append((const char *)&size, sizeof(size));
+            reply.append(pickled);
+        }
+        catch (const std::exception& err)
+        {
+            reply.assign(1, 1);
+            uint64_t size = std::strlen(err.what());
+            reply.append((const char *)&size, sizeof(size));
+            reply.append(err.what());
+        }
+        catch (...)
+        {
+            const std::string msg("Unknown error.");
+            reply.assign(1, 1);
+            uint64_t size = msg.size();
+            reply.append((const char *)&size, sizeof(size));
+            reply.append(msg);
+        }
+        if (!sendAll(fd, reply.data(), reply.size()))
+            return;
+    }
+}
+
+
+void ProcessRunner::run(std::vector<PointViewPtr>& chunks,
+    std::vector<PointViewSet>& chunkSets,
+    std::vector<std::vector<int64_t>>& chunkLabels,
+    MetadataNode stageMetadata)
+{
+    gil_scoped_acquire acquire;
+
+    if (chunks.empty())
+        return;
+    BasePointTable& table = chunks.front()->table();
+    if (!dynamic_cast<SimplePointTable *>(&table))
+        throw pdal_error("Processes can only be used with tables that "
+            "store points by row.");
+    PointLayoutPtr layout(table.layout());
+    const size_t pointSize = layout->pointSize();
+
+    // Workers are kept for later runs.  They have copies of the layout
+    // as it was when they were forked, so they're replaced if it's
+    // changed.
+    if (!m_pool || m_pool->m_layout != layout ||
+        m_pool->m_pointSize != pointSize)
+    {
+        m_pool.reset();
+        startPool(layout);
+    }
+
+    std::vector<char> splits(chunks.size());
+    std::vector<std::vector<int64_t>> labels(chunks.size());
+    std::vector<std::string> metadata(chunks.size());
+    std::string error;
+    bool lost = false;
+    {
+        gil_scoped_release release;
+
+        std::vector<Pool::Worker>& workers = m_pool->m_workers;
+        const size_t numWorkers = (std::min)(workers.size(), chunks.size());
+        std::vector<size_t> current(numWorkers);
+        std::vector<char> rows;
+        size_t next = 0;
+
+        // Sends the next slice to a worker, returning false if it's gone.
+        auto send = [&](size_t w)
+        {
+            size_t c = current[w] = next++;
+            PointViewPtr chunk = chunks[c];
+            uint64_t count = chunk->size();
+            rows.resize(count * pointSize);
+            for (PointId idx = 0; idx < count; ++idx)
+                std::memcpy(rows.data() + idx * pointSize,
+                    chunk->getPoint(idx), pointSize);
+            return sendAll(workers[w].m_socket, &count, sizeof(count)) &&
+                sendAll(workers[w].m_socket, rows.data(), rows.size());
+        };
+
+        // Reads a worker's results, copying the rows back into the
+        // slice's points.  Returns false if the worker is gone.
+        auto receive = [&](size_t w)
+        {
+            const int fd = workers[w].m_socket;
+            size_t c = current[w];
+            char status;
+            if (!recvAll(fd, &status, 1))
+                return false;
+            if (status)
+            {
+                std::string msg;
+                if (!recvString(fd, msg))
+                    return false;
+                if (error.empty())
+                    error = msg;
+                return true;
+            }
+
+            PointViewPtr chunk = chunks[c];
+            const point_count_t count = chunk->size();
+            rows.resize(count * pointSize);
+            labels[c].resize(count);
+            if (!recvAll(fd, &splits[c], 1) ||
+                !recvAll(fd, rows.data(), rows.size()) ||
+                !recvAll(fd, labels[c].data(), count * sizeof(int64_t)) ||
+                !recvString(fd, metadata[c]))
+                return false;
+            for (PointId idx = 0; idx < count; ++idx)
+                std::memcpy(chunk->getPoint(idx),
+                    rows.data() + idx * pointSize, pointSize);
+            return true;
+        };
+
+        // Each worker is given another slice as soon as it's done, until
+        // they're all done or one fails.
+        std::vector<pollfd> fds;
+        std::vector<size_t> owners;
+        for (size_t w = 0; w < numWorkers; ++w)
+        {
+            if (!send(w))
+            {
+                lost = true;
+                break;
+            }
+            fds.push_back({ workers[w].m_socket, POLLIN, 0 });
+            owners.push_back(w);
+        }
+        while (fds.size())
+        {
+            if (poll(fds.data(), fds.size(), -1) < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                error = std::strerror(errno);
+                lost = true;
+                break;
+            }
+            for (size_t i = 0; i < fds.size();)
+            {
+                if (!fds[i].revents)
+                {
+                    ++i;
+                    continue;
+                }
+                size_t w = owners[i];
+                if (!receive(w))
+                    lost = true;
+                else if (error.empty() && !lost && next < chunks.size())
+                {
+                    if (send(w))
+                    {
+                        ++i;
+                        continue;
+                    }
+                    lost = true;
+                }
+                fds.erase(fds.begin() + i);
+                owners.erase(owners.begin() + i);
+            }
+        }
+    }
+
+    // A worker that went away leaves the others out of step, so they're
+    // all replaced next time.
+    if (lost)
+    {
+        m_pool.reset();
+        throw pdal_error("A worker process ended unexpectedly." +
+            (error.size() ? " " + error : std::string()));
+    }
+    if (error.size())
+        throw pdal_error(error);
+
+    // Make the views that each worker's results describe.
+    for (size_t c = 0; c < chunks.size(); ++c)
+    {
+        PointViewPtr chunk = chunks[c];
+
+        // Views are made in order of label, as a split makes them.
+        std::map<int64_t, PointIdList> ids;
+        for (PointId idx = 0; idx < chunk->size(); ++idx)
+            if (labels[c][idx] >= 0)
+                ids[labels[c][idx]].push_back(idx);
+        if (!splits[c])
+            ids[0];
+
+        chunkSets[c].clear();
+        chunkLabels[c].clear();
+        for (auto& i : ids)
+        {
+            PointViewPtr view = chunk->makeNew();
+            for (PointId idx : i.second)
+                view->appendPoint(*chunk, idx);
+            chunkSets[c].insert(view);
+            if (splits[c])
+                chunkLabels[c].push_back(i.first);
+        }
+    }
+
+    for (const std::string& m : metadata)
+    {
+        PyObject *bytes = PyBytes_FromStringAndSize(m.data(), m.size());
+        PyObject *list = callPickle("loads", bytes);
+        Py_DECREF(bytes);
+        for (Py_ssize_t i = 0; i < PyList_Size(list); ++i)
+            addNode(PyList_GetItem(list, i), stageMetadata);
+        Py_DECREF(list);
+    }
+}
+
+#else
+
+struct ProcessRunner::Pool
+{};
+
+
+ProcessRunner::ProcessRunner(Invocation& method, size_t numProcesses) :
+    m_method(method), m_numProcesses(numProcesses)
+{
+    throw pdal_error("Running in more than one process isn't supported "
+        "on this platform.");
+}
+
+
+ProcessRunner::~ProcessRunner()
+{}
+
+
+void ProcessRunner::run(std::vector<PointViewPtr>& chunks,
+    std::vector<PointViewSet>& chunkSets,
+    std::vector<std::vector<int64_t>>& chunkLabels,
+    MetadataNode stageMetadata)
+{}
+
+#endif
+
+} // namespace plang
+} // namespace pdal
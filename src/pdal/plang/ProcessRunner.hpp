@@ -0,0 +1,89 @@
+/******************************************************************************
+* Copyright (c) 2026, Hobu Inc. (info@hobu.co)
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following
+* conditions are met:
+*
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in
+*       the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of Hobu, Inc. or Flaxen Geo Consulting nor the
+*       names of its contributors may be used to endorse or promote
+*       products derived from this software without specific prior
+*       written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+* COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+* OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+* AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+* OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+* OF SUCH DAMAGE.
+****************************************************************************/
+
+#pragma once
+
+#include "Invocation.hpp"
+
+#include <pdal/PointView.hpp>
+
+#include <memory>
+#include <vector>
+
+// PDAL renamed this but it is not aliased on windows for PDAL 2.9
+#   define PDAL_DLL     PDAL_EXPORT
+
+namespace pdal
+{
+namespace plang
+{
+
+// Runs slices of a view through an invocation in forked processes, so
+// that functions that hold the GIL can use several cores.  The processes
+// are forked on the first run and kept until the runner is destroyed, so
+// module state that the function changes in one of them stays there.
+// Points are sent to them over sockets and sent back once the function
+// has run.  Only available where fork() is.
+class PDAL_DLL ProcessRunner
+{
+public:
+    ProcessRunner(Invocation& method, size_t numProcesses);
+    ~ProcessRunner();
+
+    ProcessRunner(const ProcessRunner&) = delete;
+    ProcessRunner& operator=(const ProcessRunner&) = delete;
+
+    // Has the effect of calling the invocation's execute() for each of
+    // 'chunks', which must be views of the same row-oriented table, with
+    // 'chunkSets' and 'chunkLabels' getting each one's views and labels.
+    // Metadata that the function adds is added to 'stageMetadata'.
+    // Functions can't add points, and an 'Indices' output must be in
+    // increasing order.
+    void run(std::vector<PointViewPtr>& chunks,
+        std::vector<PointViewSet>& chunkSets,
+        std::vector<std::vector<int64_t>>& chunkLabels,
+        MetadataNode stageMetadata);
+
+private:
+    void startPool(PointLayoutPtr layout);
+    void serve(int fd, PointLayout& layout);
+
+    Invocation& m_method;
+    size_t m_numProcesses;
+    struct Pool;
+    std::unique_ptr<Pool> m_pool;
+};
+
+} // namespace plang
+} // namespace pdal
@@ -15,6 +15,7 @@
 #include <ostream>
 #include <string>
 #include <iostream>
+#include <mutex>
 
 namespace pdal
 {
@@ -28,6 +29,9 @@ struct Stdout
     Redirector::stdout_flush_type flush;
 };
 
+// Without a GIL, several threads may print at once.
+static std::mutex s_stdoutMutex;
+
 
 static PyObject* Stdout_write(PyObject* self, PyObject* args)
 {
@@ -41,6 +45,7 @@ static PyObject* Stdout_write(PyObject* self, PyObject* args)
             return 0;
 
         std::string str(data);
+        std::lock_guard<std::mutex> lock(s_stdoutMutex);
         selfimpl->write(str);
         written = str.size();
     }
@@ -52,6 +57,7 @@ static PyObject* Stdout_flush(PyObject* self, PyObject* /*args*/)
 {
     gil_scoped_acquire acquire;
     Stdout *selfimpl = reinterpret_cast<Stdout *>(self);
+    std::lock_guard<std::mutex> lock(s_stdoutMutex);
     if (selfimpl->flush)
     {
         selfimpl->flush();
@@ -170,6 +176,10 @@ PyObject* Redirector::init()
         Py_INCREF(reinterpret_cast<PyObject*>(&StdoutType));
         PyModule_AddObject(m, "Stdout", reinterpret_cast<PyObject*>(&StdoutType));
 #pragma GCC diagnostic pop
+#ifdef Py_GIL_DISABLED
+        // Otherwise importing the module turns the GIL back on.
+        PyUnstable_Module_SetGIL(m, Py_MOD_GIL_NOT_USED);
+#endif
     }
     return m;
 }
@@ -198,8 +208,11 @@ void Redirector::set_stdout(stdout_write_type write, stdout_flush_type flush)
     }
 
     Stdout* impl = reinterpret_cast<Stdout*>(m_stdout);
-    impl->write = write;
-    impl->flush = flush;
+    {
+        std::lock_guard<std::mutex> lock(s_stdoutMutex);
+        impl->write = write;
+        impl->flush = flush;
+    }
     PySys_SetObject(const_cast<char*>("stdout"), m_stdout);
 }
 
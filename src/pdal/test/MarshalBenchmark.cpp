@@ -0,0 +1,183 @@
+/******************************************************************************
+* Copyright (c) 2026, Hobu Inc. (info@hobu.co)
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following
+* conditions are met:
+*
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in
+*       the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of Hobu, Inc. or Flaxen Geo Consulting nor the
+*       names of its contributors may be used to endorse or promote
+*       products derived from this software without specific prior
+*       written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+* COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+* OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+* AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+* OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+* OF SUCH DAMAGE.
+****************************************************************************/
+
+// Measures how fast dimensions are copied between a row-oriented point
+// table and packed per-dimension buffers, point by point through
+// PointView::getField()/setField() (the original marshaling loops) and in
+// bulk with the run-based kernels used by filters.python.  Scattering
+// byte-swapped values, as readers.numpy does for big-endian arrays, is
+// measured the same two ways.
+//
+// Usage: pdal_plang_marshal_bench [point count]
+
+#include <pdal/PointTable.hpp>
+#include <pdal/PointView.hpp>
+
+#include "../plang/Marshal.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+using namespace pdal;
+
+namespace
+{
+
+typedef std::chrono::steady_clock Clock;
+
+double seconds(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+void report(const std::string& what, point_count_t count, double secs)
+{
+    std::cout << what << ": " << secs << " s, " <<
+        (point_count_t)(count / secs) << " points/sec" << std::endl;
+}
+
+} // unnamed namespace
+
+int main(int argc, char *argv[])
+{
+    using namespace Dimension;
+
+    point_count_t count = 10000000;
+    if (argc > 1)
+        count = std::strtoull(argv[1], nullptr, 10);
+
+    PointTable table;
+    PointLayoutPtr layout = table.layout();
+    const IdList ids { Id::X, Id::Y, Id::Z, Id::Intensity, Id::ReturnNumber,
+        Id::NumberOfReturns, Id::Classification, Id::PointSourceId,
+        Id::GpsTime, Id::Red, Id::Green, Id::Blue };
+    for (Id id : ids)
+        layout->registerDim(id);
+
+    PointView view(table);
+    for (PointId idx = 0; idx < count; ++idx)
+    {
+        view.setField(Id::X, idx, idx);
+        view.setField(Id::Classification, idx, idx % 32);
+    }
+
+    const IdList& dims = layout->dims();
+    const size_t pointSize = layout->pointSize();
+    std::vector<std::vector<char>> buffers;
+    for (Id d : dims)
+        buffers.emplace_back(layout->dimSize(d) * count);
+
+    std::cout << count << " points, " << dims.size() << " dimensions, " <<
+        pointSize << " bytes per point" << std::endl;
+
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < dims.size(); ++i)
+    {
+        Type t = layout->dimType(dims[i]);
+        size_t size = layout->dimSize(dims[i]);
+        char *p = buffers[i].data();
+        for (PointId idx = 0; idx < count; ++idx)
+        {
+            view.getField(p, dims[i], t, idx);
+            p += size;
+        }
+    }
+    report("getField gather", count, seconds(start));
+
+    start = Clock::now();
+    plang::PointRunList runs = plang::findRuns(view);
+    for (size_t i = 0; i < dims.size(); ++i)
+    {
+        const Detail *dd = layout->dimDetail(dims[i]);
+        plang::gatherDim(runs, pointSize, dd->offset(), dd->size(),
+            buffers[i].data());
+    }
+    report("bulk gather", count, seconds(start));
+
+    start = Clock::now();
+    for (size_t i = 0; i < dims.size(); ++i)
+    {
+        Type t = layout->dimType(dims[i]);
+        size_t size = layout->dimSize(dims[i]);
+        char *p = buffers[i].data();
+        for (PointId idx = 0; idx < count; ++idx)
+        {
+            view.setField(dims[i], t, idx, p);
+            p += size;
+        }
+    }
+    report("setField scatter", count, seconds(start));
+
+    start = Clock::now();
+    runs = plang::findRuns(view);
+    for (size_t i = 0; i < dims.size(); ++i)
+    {
+        const Detail *dd = layout->dimDetail(dims[i]);
+        plang::scatterDim(runs, pointSize, dd->offset(), dd->size(),
+            buffers[i].data(), count);
+    }
+    report("bulk scatter", count, seconds(start));
+
+    // The buffers' byte order doesn't matter to the timing.
+    start = Clock::now();
+    for (size_t i = 0; i < dims.size(); ++i)
+    {
+        Type t = layout->dimType(dims[i]);
+        size_t size = layout->dimSize(dims[i]);
+        char *p = buffers[i].data();
+        char buf[8];
+        for (PointId idx = 0; idx < count; ++idx)
+        {
+            std::reverse_copy(p, p + size, buf);
+            view.setField(dims[i], t, idx, buf);
+            p += size;
+        }
+    }
+    report("setField swapped scatter", count, seconds(start));
+
+    start = Clock::now();
+    runs = plang::findRuns(view);
+    for (size_t i = 0; i < dims.size(); ++i)
+    {
+        const Detail *dd = layout->dimDetail(dims[i]);
+        plang::scatterDim(runs, pointSize, dd->offset(), dd->size(),
+            buffers[i].data(), dd->size(), count, true);
+    }
+    report("bulk swapped scatter", count, seconds(start));
+
+    return 0;
+}
@@ -39,13 +39,19 @@
 #include <pdal/PipelineManager.hpp>
 #include <pdal/StageFactory.hpp>
 #include <pdal/filters/StatsFilter.hpp>
+#include <pdal/filters/StreamCallbackFilter.hpp>
 
 #include "../io/NumpyReader.hpp"
 
 #include <pdal/StageWrapper.hpp>
+#include <pdal/util/FileUtils.hpp>
 
 #include "Support.hpp"
 
+#include <algorithm>
+#include <fstream>
+#include <vector>
+
 using namespace pdal;
 
 TEST(NumpyReaderTest, NumpyReaderTest_read_fields)
@@ -335,3 +341,260 @@ TEST(NumpyReaderTest, four_floats_script)
         EXPECT_EQ(t, (int)id * 4 * factor);
     }
 }
+
+// Reading in chunks that split the iterator's inner loops gives the same
+// points as reading all at once, in standard and streaming modes.
+TEST(NumpyReaderTest, chunks)
+{
+    Options ops;
+    ops.add("filename", Support::datapath("perlin.npy"));
+
+    NumpyReader reader;
+    reader.setOptions(ops);
+
+    PointTable table;
+    reader.prepare(table);
+    PointViewSet viewSet = reader.execute(table);
+    PointViewPtr view = *viewSet.begin();
+    ASSERT_EQ(view->size(), 10000u);
+
+    NumpyReader streamReader;
+    streamReader.setOptions(ops);
+
+    PointId idx = 0;
+    StreamCallbackFilter cb;
+    cb.setCallback([&idx, view](PointRef& point)
+    {
+        EXPECT_EQ(point.getFieldAs<double>(Dimension::Id::Intensity),
+            view->getFieldAs<double>(Dimension::Id::Intensity, idx));
+        EXPECT_EQ(point.getFieldAs<uint32_t>(Dimension::Id::X),
+            view->getFieldAs<uint32_t>(Dimension::Id::X, idx));
+        EXPECT_EQ(point.getFieldAs<uint32_t>(Dimension::Id::Y),
+            view->getFieldAs<uint32_t>(Dimension::Id::Y, idx));
+        idx++;
+        return true;
+    });
+    cb.setInput(streamReader);
+
+    FixedPointTable streamTable(333);
+    cb.prepare(streamTable);
+    cb.execute(streamTable);
+    EXPECT_EQ(idx, 10000u);
+}
+
+TEST(NumpyReaderTest, start_count)
+{
+    Options ops;
+    ops.add("filename", Support::datapath("perlin.npy"));
+    ops.add("start", 5000);
+    ops.add("count", 24);
+
+    // The count is known before reading.
+    NumpyReader preview;
+    preview.setOptions(ops);
+    QuickInfo qi = preview.preview();
+    EXPECT_TRUE(qi.valid());
+    EXPECT_EQ(qi.m_pointCount, 24u);
+
+    NumpyReader reader;
+    reader.setOptions(ops);
+
+    PointTable table;
+    reader.prepare(table);
+    PointViewSet viewSet = reader.execute(table);
+    PointViewPtr view = *viewSet.begin();
+    ASSERT_EQ(view->size(), 24u);
+
+    // Positions are those in the whole array.
+    EXPECT_EQ(view->getFieldAs<double>(Dimension::Id::Intensity, 0), 0.5);
+    EXPECT_EQ(view->getFieldAs<uint32_t>(Dimension::Id::X, 0), 50u);
+    EXPECT_EQ(view->getFieldAs<uint32_t>(Dimension::Id::X, 23), 50u);
+    EXPECT_EQ(view->getFieldAs<uint32_t>(Dimension::Id::Y, 23), 23u);
+}
+
+// An array handed to setArray() survives preview() and is read after it.
+TEST(NumpyReaderTest, preview_set_array)
+{
+    plang::Environment::get();
+
+    NumpyReader reader;
+    {
+        plang::gil_scoped_acquire acquire;
+        PyObject *numpy = PyImport_ImportModule("numpy");
+        ASSERT_TRUE(numpy);
+        PyObject *array = PyObject_CallMethod(numpy, "arange", "is", 10,
+            "float64");
+        Py_DECREF(numpy);
+        ASSERT_TRUE(array);
+        reader.setArray(array);
+        Py_DECREF(array);
+    }
+
+    Options ops;
+    reader.setOptions(ops);
+    QuickInfo qi = reader.preview();
+    EXPECT_TRUE(qi.valid());
+    EXPECT_EQ(qi.m_pointCount, 10u);
+
+    PointTable table;
+    reader.prepare(table);
+    PointViewSet viewSet = reader.execute(table);
+    PointViewPtr view = *viewSet.begin();
+    ASSERT_EQ(view->size(), 10u);
+    for (PointId idx = 0; idx < view->size(); ++idx)
+        EXPECT_EQ(view->getFieldAs<double>(Dimension::Id::Intensity, idx),
+            (double)idx);
+}
+
+// A file written by hand, with mixed byte orders and padding, is read
+// without numpy.
+TEST(NumpyReaderTest, threads)
+{
+    Options ops;
+    ops.add("filename", Support::datapath("perlin.npy"));
+
+    NumpyReader reader;
+    reader.setOptions(ops);
+    PointTable table;
+    reader.prepare(table);
+    PointViewPtr view = *reader.execute(table).begin();
+
+    ops.add("threads", 4);
+    NumpyReader threadedReader;
+    threadedReader.setOptions(ops);
+    PointTable threadedTable;
+    threadedReader.prepare(threadedTable);
+    PointViewPtr threadedView =
+        *threadedReader.execute(threadedTable).begin();
+
+    ASSERT_EQ(threadedView->size(), view->size());
+    for (PointId idx = 0; idx < view->size(); ++idx)
+    {
+        EXPECT_EQ(threadedView->getFieldAs<double>(Dimension::Id::Intensity,
+            idx), view->getFieldAs<double>(Dimension::Id::Intensity, idx));
+        EXPECT_EQ(threadedView->getFieldAs<uint32_t>(Dimension::Id::X, idx),
+            view->getFieldAs<uint32_t>(Dimension::Id::X, idx));
+        EXPECT_EQ(threadedView->getFieldAs<uint32_t>(Dimension::Id::Y, idx),
+            view->getFieldAs<uint32_t>(Dimension::Id::Y, idx));
+    }
+}
+
+// Byte-swapped values copied into table memory, as for big-endian
+// arrays.  Counts are chosen so that runs end part way through any
+// unrolled or vector loop.
+TEST(NumpyReaderTest, swap)
+{
+    for (size_t size : { 1, 2, 3, 4, 8 })
+    for (size_t srcStride : { size, size + 4 })
+    for (size_t pointSize : { size, (size_t)24 })
+    for (point_count_t count : { 0, 1, 7, 15, 16, 17, 33, 255, 257 })
+    {
+        std::vector<char> src(srcStride * count);
+        for (size_t i = 0; i < src.size(); ++i)
+            src[i] = (char)(i * 7 + 3);
+
+        // Two runs, with a point between them that's left alone.
+        const point_count_t first = count / 3;
+        std::vector<char> dst((count + 1) * pointSize + 1);
+        std::vector<char> expected(dst);
+        plang::PointRunList runs {
+            { dst.data() + 1, first },
+            { dst.data() + 1 + (first + 1) * pointSize, count - first } };
+        plang::scatterDim(runs, pointSize, 0, size, src.data(), srcStride,
+            count, true);
+
+        for (point_count_t i = 0; i < count; ++i)
+        {
+            const char *value = src.data() + i * srcStride;
+            const PointId pos = (i < first) ? i : i + 1;
+            std::reverse_copy(value, value + size,
+                expected.data() + 1 + pos * pointSize);
+        }
+        EXPECT_EQ(dst, expected) << "size " << size << ", source stride " <<
+            srcStride << ", point size " << pointSize << ", count " << count;
+    }
+}
+
+TEST(NumpyReaderTest, mapped_file)
+{
+    std::string header("{'descr': [('X', '>i4'), ('', '|V4'), "
+        "('Y', '<f8')], 'fortran_order': False, 'shape': (3,), }");
+    // The magic string, version and length are 10 bytes.  The header is
+    // padded so the data is aligned.
+    header.resize(128 - 10 - 1, ' ');
+    header += '\n';
+
+    const std::string filename(Support::temppath("mapped.npy"));
+    {
+        std::ofstream out(filename, std::ios::binary);
+        out.write("\x93NUMPY\x01\x00", 8);
+        const char len[2] = { (char)header.size(), 0 };
+        out.write(len, 2);
+        out << header;
+        for (int i = 0; i < 3; ++i)
+        {
+            const char x[4] = { 0, 0, 1, (char)i };   // 256 + i, big-endian
+            const char pad[4] = {};
+            double y = i * 1.5;
+            out.write(x, 4);
+            out.write(pad, 4);
+            out.write(reinterpret_cast<const char *>(&y), 8);
+        }
+    }
+
+    Options ops;
+    ops.add("filename", filename);
+
+    NumpyReader reader;
+    reader.setOptions(ops);
+
+    PointTable table;
+    reader.prepare(table);
+    PointViewSet viewSet = reader.execute(table);
+    PointViewPtr view = *viewSet.begin();
+    ASSERT_EQ(view->size(), 3u);
+    for (PointId i = 0; i < 3; ++i)
+    {
+        EXPECT_EQ(view->getFieldAs<int>(Dimension::Id::X, i), 256 + (int)i);
+        EXPECT_DOUBLE_EQ(view->getFieldAs<double>(Dimension::Id::Y, i),
+            i * 1.5);
+    }
+    FileUtils::deleteFile(filename);
+}
+
+// Shapes whose size overflows mustn't be taken for ones the file holds.
+TEST(NumpyReaderTest, bad_shape)
+{
+    const std::string shapes[] {
+        "(3, 6148914691236517206)",     // The product wraps to 2.
+        "(18446744073709551618,)",      // Too large for 64 bits.
+        "(9223372036854775808,)"        // Too large for a signed size.
+    };
+    const std::string filename(Support::temppath("bad_shape.npy"));
+    for (const std::string& shape : shapes)
+    {
+        std::string header("{'descr': '<i8', 'fortran_order': False, "
+            "'shape': " + shape + ", }");
+        header.resize(128 - 10 - 1, ' ');
+        header += '\n';
+        {
+            std::ofstream out(filename, std::ios::binary);
+            out.write("\x93NUMPY\x01\x00", 8);
+            const char len[2] = { (char)header.size(), 0 };
+            out.write(len, 2);
+            out << header;
+            const char data[16] = {};
+            out.write(data, 16);
+        }
+
+        Options ops;
+        ops.add("filename", filename);
+
+        NumpyReader reader;
+        reader.setOptions(ops);
+
+        PointTable table;
+        EXPECT_THROW(reader.prepare(table), pdal_error) << shape;
+    }
+    FileUtils::deleteFile(filename);
+}
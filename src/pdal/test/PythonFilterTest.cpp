@@ -40,15 +40,22 @@
 #include <pdal/StageFactory.hpp>
 #include <pdal/io/FauxReader.hpp>
 #include <pdal/filters/StatsFilter.hpp>
+#include <pdal/filters/StreamCallbackFilter.hpp>
 #include <pdal/util/FileUtils.hpp>
 
 #include "../plang/Invocation.hpp"
 #include "../plang/Environment.hpp"
 
+#include <marshal.h>
+
 #include <pdal/StageWrapper.hpp>
 
 #include "Support.hpp"
 
+#include <algorithm>
+#include <fstream>
+#include <vector>
+
 using namespace pdal;
 using namespace pdal::plang;
 
@@ -741,223 +748,1079 @@ TEST(PLangTest, PLangTest_aliases)
 }
 
 
-TEST(PLangTest, PLangTest_returntrue)
+TEST(PLangTest, zero_copy)
 {
     const char* source =
         "import numpy as np\n"
         "def yow(ins,outs):\n"
+        "  X = ins['X']\n"
+        "  X *= 2\n"
+        "  outs['Y'] = X + 1\n"
         "  return True\n"
         ;
-    Script script(source, "MyTest", "yow");
-    Invocation meth(script, MetadataNode(), "");
 
     PointTable table;
+    table.layout()->registerDim(Dimension::Id::X);
+    table.layout()->registerDim(Dimension::Id::Y);
     PointViewPtr view(new PointView(table));
+    for (PointId idx = 0; idx < 5; ++idx)
+        view->setField(Dimension::Id::X, idx, idx);
 
+    Script script(source, "MyTest", "yow");
+    Invocation meth(script, MetadataNode(), "");
+    meth.setZeroCopy(true);
     EXPECT_TRUE(meth.execute(view, MetadataNode()));
+
+    for (PointId idx = 0; idx < 5; ++idx)
+    {
+        EXPECT_DOUBLE_EQ(view->getFieldAs<double>(Dimension::Id::X, idx),
+            2.0 * idx);
+        EXPECT_DOUBLE_EQ(view->getFieldAs<double>(Dimension::Id::Y, idx),
+            2.0 * idx + 1);
+    }
 }
 
 
-TEST(PLangTest, PLangTest_returnfalse)
+// An input array kept by the script no longer sees the points once the
+// call is done.
+TEST(PLangTest, zero_copy_kept)
 {
     const char* source =
         "import numpy as np\n"
+        "kept = []\n"
         "def yow(ins,outs):\n"
-        "  return False\n"
+        "  if not kept:\n"
+        "    kept.append(ins['X'])\n"
+        "  outs['Y'] = kept[0] + 0\n"
+        "  return True\n"
         ;
-    Script script(source, "MyTest", "yow");
-    Invocation meth(script, MetadataNode(), "");
 
     PointTable table;
+    table.layout()->registerDim(Dimension::Id::X);
+    table.layout()->registerDim(Dimension::Id::Y);
     PointViewPtr view(new PointView(table));
-    EXPECT_FALSE(meth.execute(view, MetadataNode()));
-}
-
+    for (PointId idx = 0; idx < 5; ++idx)
+        view->setField(Dimension::Id::X, idx, idx);
 
-//---------------------------------------------------------------------------
-//
-// MISC tests
-//
-//---------------------------------------------------------------------------
+    Script script(source, "MyTest", "yow");
+    Invocation meth(script, MetadataNode(), "");
+    meth.setZeroCopy(true);
+    EXPECT_TRUE(meth.execute(view, MetadataNode()));
 
-TEST(PLangTest, log)
-{
-    // verify we can redirect the stdout inside the python script
+    for (PointId idx = 0; idx < 5; ++idx)
+        view->setField(Dimension::Id::X, idx, 100);
+    EXPECT_TRUE(meth.execute(view, MetadataNode()));
 
-    std::string logfile("mylog_three.txt");
-//    std::string logfile(Support::temppath("mylog_three.txt"));
+    for (PointId idx = 0; idx < 5; ++idx)
+        EXPECT_DOUBLE_EQ(view->getFieldAs<double>(Dimension::Id::Y, idx),
+            (double)idx);
+}
 
-    Options reader_opts;
-    {
-        BOX3D bounds(1.0, 2.0, 3.0, 101.0, 102.0, 103.0);
-        Option opt1("bounds", bounds);
-        Option opt2("count", 750);
-        Option opt3("mode", "constant");
+TEST(PLangTest, noncontiguous)
+{
+    const char* source =
+        "import numpy as np\n"
+        "def yow(ins,outs):\n"
+        "  outs['Y'] = ins['X'] * 3\n"
+        "  return True\n"
+        ;
 
-        reader_opts.add(opt1);
-        reader_opts.add(opt2);
-        reader_opts.add(opt3);
+    PointTable table;
+    table.layout()->registerDim(Dimension::Id::X);
+    table.layout()->registerDim(Dimension::Id::Y);
+    PointViewPtr view(new PointView(table));
+    for (PointId idx = 0; idx < 100000; ++idx)
+        view->setField(Dimension::Id::X, idx, idx);
 
-        Option optlog("log", logfile);
-        reader_opts.add(optlog);
-    }
+    // Every third point, so the points are spread over several runs.
+    PointViewPtr subset = view->makeNew();
+    for (PointId idx = 0; idx < view->size(); idx += 3)
+        subset->appendPoint(*view, idx);
 
-    Options xfilter_opts;
-    {
-        const Option source("source",
-            "import numpy as np\n"
-            "import sys\n"
-            "def xfunc(ins,outs):\n"
-            "  X = ins['X']\n"
-            "  print (\"Testing log output through python script.\")\n"
-            "  X = X + 1.0\n"
-            "  outs['X'] = X\n"
-            "  sys.stdout.flush()\n"
-            "  return True\n"
-            );
-        const Option module("module", "xModule");
-        const Option function("function", "xfunc");
-        xfilter_opts.add("log", logfile);
-        xfilter_opts.add(source);
-        xfilter_opts.add(module);
-        xfilter_opts.add(function);
-    }
+    Script script(source, "MyTest", "yow");
+    Invocation meth(script, MetadataNode(), "");
+    EXPECT_TRUE(meth.execute(subset, MetadataNode()));
 
-    StageFactory f;
-    {
-        FauxReader reader;
+    for (PointId idx = 0; idx < subset->size(); ++idx)
+        EXPECT_DOUBLE_EQ(subset->getFieldAs<double>(Dimension::Id::Y, idx),
+            9.0 * idx);
+}
 
-        reader.setOptions(reader_opts);
 
-        Stage* xfilter(f.createStage("filters.python"));
-        xfilter->setOptions(xfilter_opts);
-        xfilter->setInput(reader);
+TEST(PLangTest, lazy_ins)
+{
+    const char* source =
+        "import json\n"
+        "import numpy as np\n"
+        "def yow(ins,outs):\n"
+        "  assert isinstance(ins, dict)\n"
+        "  assert len(ins) == 3\n"
+        "  assert list(ins) == ['X', 'Y', 'Z']\n"
+        "  assert list(ins.keys()) == ['X', 'Y', 'Z']\n"
+        "  assert 'X' in ins and 'Intensity' not in ins\n"
+        "  assert ins['X'] is ins['X']\n"
+        "  assert ins.get('Intensity') is None\n"
+        "  d = dict(ins)\n"
+        "  assert isinstance(ins.copy(), dict)\n"
+        "  assert np.array_equal(d['Y'], ins['X'] * 2)\n"
+        "  assert ins.keys() & {'X', 'Intensity'} == {'X'}\n"
+        "  assert ins.setdefault('Q', 1) == 1 and ins.pop('Q') == 1\n"
+        "  ins.update(Q=2)\n"
+        "  assert list(ins) == ['X', 'Y', 'Z', 'Q']\n"
+        "  del ins['Q']\n"
+        "  assert list(json.loads(json.dumps({k: v.tolist() "
+            "for k, v in ins.items()}))) == ['X', 'Y', 'Z']\n"
+        "  assert ins == d\n"
+        "  outs['Z'] = ins['X'] + ins['Y']\n"
+        "  return True\n"
+        ;
 
-        PointTable table;
-        xfilter->prepare(table);
-        PointViewSet pvSet = xfilter->execute(table);
-        EXPECT_EQ(pvSet.size(), 1u);
-        PointViewPtr view = *pvSet.begin();
-        EXPECT_EQ(view->size(), 750u);
+    PointTable table;
+    table.layout()->registerDim(Dimension::Id::X);
+    table.layout()->registerDim(Dimension::Id::Y);
+    table.layout()->registerDim(Dimension::Id::Z);
+    PointViewPtr view(new PointView(table));
+    for (PointId idx = 0; idx < 10; ++idx)
+    {
+        view->setField(Dimension::Id::X, idx, idx);
+        view->setField(Dimension::Id::Y, idx, 2 * idx);
     }
 
-    bool ok = Support::compare_text_files(logfile,
-        Support::datapath("logs/log_py.txt"));
-
-    // TODO: fails on Windows
-    // unknown file: error: C++ exception with description "pdalboost::filesystem::remove:
-    // The process cannot access the file because it is being used by another process:
-    // "C:/projects/pdal/test/data/../temp/mylog_three.txt"" thrown in the test body.
-    if (ok)
-        FileUtils::deleteFile(Support::temppath("mylog_three.txt"));
+    Script script(source, "MyTest", "yow");
+    Invocation meth(script, MetadataNode(), "");
+    EXPECT_TRUE(meth.execute(view, MetadataNode()));
 
-    EXPECT_TRUE(ok);
+    for (PointId idx = 0; idx < 10; ++idx)
+        EXPECT_DOUBLE_EQ(view->getFieldAs<double>(Dimension::Id::Z, idx),
+            3.0 * idx);
 }
 
 
-TEST_F(PythonFilterTest, ErrorTest1)
+TEST(PLangTest, projection)
 {
-    StageFactory f;
+    const char* source =
+        "import numpy as np\n"
+        "def yow(ins,outs):\n"
+        "  assert list(ins) == ['X']\n"
+        "  outs['Y'] = ins['X'] * 2\n"
+        "  return True\n"
+        ;
 
-    BOX3D bounds(0.0, 0.0, 0.0, 1.0, 1.0, 1.0);
+    PointTable table;
+    table.layout()->registerDim(Dimension::Id::X);
+    table.layout()->registerDim(Dimension::Id::Y);
+    table.layout()->registerDim(Dimension::Id::Z);
+    PointViewPtr view(new PointView(table));
+    for (PointId idx = 0; idx < 10; ++idx)
+        view->setField(Dimension::Id::X, idx, idx);
 
-    Options ops;
-    ops.add("bounds", bounds);
-    ops.add("count", 10);
-    ops.add("mode", "ramp");
+    Script script(source, "MyTest", "yow");
+    Invocation meth(script, MetadataNode(), "");
+    meth.setInputDims({"X"});
+    meth.setOutputDims({"Y"});
+    EXPECT_TRUE(meth.execute(view, MetadataNode()));
+    for (PointId idx = 0; idx < 10; ++idx)
+        EXPECT_DOUBLE_EQ(view->getFieldAs<double>(Dimension::Id::Y, idx),
+            2.0 * idx);
+
+    // Y isn't a permitted output.
+    Invocation meth2(script, MetadataNode(), "");
+    meth2.setInputDims({"X"});
+    meth2.setOutputDims({"Z"});
+    EXPECT_THROW(meth2.execute(view, MetadataNode()), pdal_error);
+}
 
-    FauxReader reader;
-    reader.setOptions(ops);
 
-    Option source("source", "import numpy as np\n"
-        "def myfunc(ins,outs):\n"
-        "  X = ins['X']\n"
-        "  outs['FOO'] = X\n"
-        "  return True\n"
-    );
-    Option module("module", "MyModule");
-    Option function("function", "myfunc");
-    Options opts;
-    opts.add(source);
-    opts.add(module);
-    opts.add(function);
+TEST(PLangTest, buffer_pool)
+{
+    BufferPool pool;
+
+    void *a = pool.acquire(1000);
+    EXPECT_EQ((uintptr_t)a % 64, 0u);
+    pool.release(a);
+    EXPECT_GE(pool.cachedBytes(), 1000u);
+
+    // A released buffer is reused for a request of similar size.
+    void *b = pool.acquire(900);
+    EXPECT_EQ(a, b);
+    EXPECT_EQ(pool.cachedBytes(), 0u);
+
+    // But not for a much smaller one.
+    pool.release(b);
+    void *c = pool.acquire(10);
+    EXPECT_NE(b, c);
+    pool.release(c);
+
+    // Released buffers are capped by size.  Older, larger ones make way
+    // for newer ones, and a buffer bigger than the cap isn't kept.
+    BufferPool small(false, 4096);
+    void *d = small.acquire(3000);
+    void *e = small.acquire(1000);
+    void *f = small.acquire(2000);
+    small.release(d);
+    small.release(e);
+    EXPECT_EQ(small.cachedBytes(), 4032u);
+    small.release(f);
+    EXPECT_EQ(small.cachedBytes(), 1024u + 2048u);
+    void *g = small.acquire(10000);
+    small.release(g);
+    EXPECT_EQ(small.cachedBytes(), 1024u + 2048u);
+}
 
-    Stage* filter(f.createStage("filters.python"));
-    filter->setOptions(opts);
-    filter->setInput(reader);
 
-    PointTable table;
+TEST(PLangTest, kept_ins)
+{
+    // The script holds on to an input array from the first view while
+    // later views are processed.
+    const char* source =
+        "import numpy as np\n"
+        "kept = None\n"
+        "def yow(ins,outs):\n"
+        "  global kept\n"
+        "  if kept is None:\n"
+        "    kept = ins['X']\n"
+        "  assert kept.sum() == 45\n"
+        "  return True\n"
+        ;
 
-    filter->prepare(table);
-    EXPECT_THROW(filter->execute(table), pdal_error);
+    Script script(source, "MyTest", "yow");
+    Invocation meth(script, MetadataNode(), "");
+    for (int i = 0; i < 3; ++i)
+    {
+        PointTable table;
+        table.layout()->registerDim(Dimension::Id::X);
+        PointViewPtr view(new PointView(table));
+        for (PointId idx = 0; idx < 10; ++idx)
+            view->setField(Dimension::Id::X, idx, idx * (i + 1));
+        EXPECT_TRUE(meth.execute(view, MetadataNode()));
+    }
 }
 
 
-TEST_F(PythonFilterTest, ErrorTest2)
+TEST(PLangTest, structured)
 {
-    StageFactory f;
+    const char* source =
+        "import numpy as np\n"
+        "def yow(ins,outs):\n"
+        "  assert isinstance(ins, np.ndarray)\n"
+        "  assert ins.dtype.names == ('X', 'Y')\n"
+        "  outs['Y'] = ins['X'] * 2\n"
+        "  return True\n"
+        ;
 
-    BOX3D bounds(0.0, 0.0, 0.0, 1.0, 1.0, 1.0);
+    PointTable table;
+    table.layout()->registerDim(Dimension::Id::X);
+    table.layout()->registerDim(Dimension::Id::Y);
+    PointViewPtr view(new PointView(table));
+    for (PointId idx = 0; idx < 10; ++idx)
+        view->setField(Dimension::Id::X, idx, idx);
 
-    Options ops;
-    ops.add("bounds", bounds);
-    ops.add("count", 10);
-    ops.add("mode", "ramp");
+    Script script(source, "MyTest", "yow");
+    Invocation meth(script, MetadataNode(), "");
+    meth.setStructured(true);
+    EXPECT_TRUE(meth.execute(view, MetadataNode()));
 
-    FauxReader reader;
-    reader.setOptions(ops);
+    for (PointId idx = 0; idx < 10; ++idx)
+        EXPECT_DOUBLE_EQ(view->getFieldAs<double>(Dimension::Id::Y, idx),
+            2.0 * idx);
+}
 
-    Option source("source", "import numpy as np\n"
-        "def myfunc(ins,outs):\n"
-        "  X = ins['X']\n"
-        "  outs['Mask'] = X\n"
-        "  return True\n"
-    );
-    Option module("module", "MyModule");
-    Option function("function", "myfunc");
-    Options opts;
-    opts.add("module", "MyModule");
-    opts.add("function", "myfunc");
-    opts.add(source);
 
-    Stage* filter(f.createStage("filters.python"));
-    filter->setOptions(opts);
-    filter->setInput(reader);
+TEST(PLangTest, threads)
+{
+    const char* source =
+        "import numpy as np\n"
+        "def yow(ins,outs):\n"
+        "  outs['Y'] = ins['X'] * 3\n"
+        "  return True\n"
+        ;
 
     PointTable table;
+    table.layout()->registerDim(Dimension::Id::X);
+    table.layout()->registerDim(Dimension::Id::Y);
+    PointViewPtr view(new PointView(table));
+    for (PointId idx = 0; idx < 300000; ++idx)
+        view->setField(Dimension::Id::X, idx, idx);
 
-    filter->prepare(table);
-    EXPECT_THROW(filter->execute(table), pdal_error);
+    Script script(source, "MyTest", "yow");
+    Invocation meth(script, MetadataNode(), "");
+    meth.setThreads(4);
+    EXPECT_TRUE(meth.execute(view, MetadataNode()));
+
+    for (PointId idx = 0; idx < view->size(); ++idx)
+        EXPECT_DOUBLE_EQ(view->getFieldAs<double>(Dimension::Id::Y, idx),
+            3.0 * idx);
 }
 
 
-TEST_F(PythonFilterTest, ErrorTest3)
+TEST(PLangTest, selection)
 {
-    StageFactory f;
+    auto run = [](const std::string& select)
+    {
+        std::string source =
+            "import numpy as np\n"
+            "def yow(ins,outs):\n"
+            "  keep = ins['X'] % 3 == 1\n"
+            "  " + select + "\n"
+            "  return True\n";
 
-    BOX3D bounds(0.0, 0.0, 0.0, 1.0, 1.0, 1.0);
+        PointTable table;
+        table.layout()->registerDim(Dimension::Id::X);
+        PointViewPtr view(new PointView(table));
+        for (PointId idx = 0; idx < 100; ++idx)
+            view->setField(Dimension::Id::X, idx, idx);
+
+        Script script(source, "MyTest", "yow");
+        Invocation meth(script, MetadataNode(), "");
+        EXPECT_TRUE(meth.execute(view, MetadataNode()));
+        EXPECT_EQ(view->size(), 33u);
+        for (PointId idx = 0; idx < view->size(); ++idx)
+            EXPECT_DOUBLE_EQ(view->getFieldAs<double>(Dimension::Id::X, idx),
+                3.0 * idx + 1);
+    };
+
+    run("outs['Mask'] = keep");
+    run("outs['Indices'] = np.flatnonzero(keep)");
+    run("outs['PackedMask'] = np.packbits(keep)");
+}
 
-    Options ops;
-    ops.add("bounds", bounds);
-    ops.add("count", 10);
-    ops.add("mode", "ramp");
 
-    FauxReader reader;
-    reader.setOptions(ops);
+// A uint8 'Mask' isn't taken to be packed bits.
+TEST(PLangTest, uint8_mask)
+{
+    const char* source =
+        "import numpy as np\n"
+        "def yow(ins,outs):\n"
+        "  outs['Mask'] = np.ones(len(ins['X']), dtype=np.uint8)\n"
+        "  return True\n"
+        ;
 
-    Option source("source", "import numpy as np\n"
+    PointTable table;
+    table.layout()->registerDim(Dimension::Id::X);
+    PointViewPtr view(new PointView(table));
+    for (PointId idx = 0; idx < 16; ++idx)
+        view->setField(Dimension::Id::X, idx, idx);
+
+    Script script(source, "MyTest", "yow");
+    Invocation meth(script, MetadataNode(), "");
+    EXPECT_THROW(meth.execute(view, MetadataNode()), pdal_error);
+}
+
+
+TEST(PLangTest, split)
+{
+    const char* source =
+        "import numpy as np\n"
+        "def yow(ins,outs):\n"
+        "  labels = (ins['X'] % 3).astype(np.int32)\n"
+        "  labels[ins['X'] >= 90] = -1\n"
+        "  outs['Split'] = labels\n"
+        "  return True\n"
+        ;
+
+    PointTable table;
+    table.layout()->registerDim(Dimension::Id::X);
+    PointViewPtr view(new PointView(table));
+    for (PointId idx = 0; idx < 100; ++idx)
+        view->setField(Dimension::Id::X, idx, idx);
+
+    Script script(source, "MyTest", "yow");
+    Invocation meth(script, MetadataNode(), "");
+    PointViewSet views;
+    EXPECT_TRUE(meth.execute(view, MetadataNode(), views));
+    ASSERT_EQ(views.size(), 3u);
+
+    int label = 0;
+    for (const PointViewPtr& v : views)
+    {
+        EXPECT_EQ(v->size(), 30u);
+        for (PointId idx = 0; idx < v->size(); ++idx)
+            EXPECT_DOUBLE_EQ(v->getFieldAs<double>(Dimension::Id::X, idx),
+                3.0 * idx + label);
+        label++;
+    }
+}
+
+
+TEST(PLangTest, append)
+{
+    const char* source =
+        "import numpy as np\n"
+        "def yow(ins,outs):\n"
+        "  outs['X'] = np.append(ins['X'], [100, 101, 102])\n"
+        "  outs['Z'] = np.append(ins['Z'], [7])\n"
+        "  return True\n"
+        ;
+
+    PointTable table;
+    table.layout()->registerDim(Dimension::Id::X);
+    table.layout()->registerDim(Dimension::Id::Y);
+    table.layout()->registerDim(Dimension::Id::Z);
+    PointViewPtr view(new PointView(table));
+    for (PointId idx = 0; idx < 10; ++idx)
+    {
+        view->setField(Dimension::Id::X, idx, idx);
+        view->setField(Dimension::Id::Y, idx, 1);
+        view->setField(Dimension::Id::Z, idx, 2);
+    }
+
+    Script script(source, "MyTest", "yow");
+    Invocation meth(script, MetadataNode(), "");
+    EXPECT_TRUE(meth.execute(view, MetadataNode()));
+
+    ASSERT_EQ(view->size(), 13u);
+    for (PointId idx = 10; idx < 13; ++idx)
+    {
+        EXPECT_DOUBLE_EQ(view->getFieldAs<double>(Dimension::Id::X, idx),
+            90.0 + idx);
+        EXPECT_DOUBLE_EQ(view->getFieldAs<double>(Dimension::Id::Y, idx), 0);
+    }
+    EXPECT_DOUBLE_EQ(view->getFieldAs<double>(Dimension::Id::Z, 10), 7);
+    EXPECT_DOUBLE_EQ(view->getFieldAs<double>(Dimension::Id::Z, 11), 0);
+}
+
+
+TEST(PLangTest, plan_layout_change)
+{
+    const char* source =
+        "import numpy as np\n"
+        "def yow(ins,outs):\n"
+        "  names = [d['name'] for d in schema['dimensions']]\n"
+        "  assert names == list(ins)\n"
+        "  assert pdalargs['a'] == 1\n"
+        "  return True\n"
+        ;
+
+    Script script(source, "MyTest", "yow");
+    Invocation meth(script, MetadataNode(), "{\"a\": 1}");
+
+    PointTable table1;
+    table1.layout()->registerDim(Dimension::Id::X);
+    PointViewPtr view1(new PointView(table1));
+    view1->setField(Dimension::Id::X, 0, 1.0);
+    EXPECT_TRUE(meth.execute(view1, MetadataNode()));
+
+    PointTable table2;
+    table2.layout()->registerDim(Dimension::Id::X);
+    table2.layout()->registerDim(Dimension::Id::Z);
+    PointViewPtr view2(new PointView(table2));
+    view2->setField(Dimension::Id::X, 0, 1.0);
+    EXPECT_TRUE(meth.execute(view2, MetadataNode()));
+}
+
+
+TEST(PLangTest, lazy_metadata)
+{
+    const char* source =
+        "import json\n"
+        "def yow(ins,outs):\n"
+        "  assert isinstance(metadata, dict)\n"
+        "  assert metadata['name'] == 'root'\n"
+        "  # Children aren't converted until they're needed.\n"
+        "  assert dict.__len__(metadata) == 4\n"
+        "  kids = metadata['children']\n"
+        "  assert [k['name'] for k in kids] == ['a', 'b']\n"
+        "  assert kids[1]['children'][0]['value'] == '3'\n"
+        "  j = json.loads(json.dumps(metadata))\n"
+        "  assert j['children'][1]['children'][0]['name'] == 'c'\n"
+        "  return True\n"
+        ;
+
+    MetadataNode m("root");
+    m.add("a", 1);
+    MetadataNode b = m.add("b", 2);
+    b.add("c", 3);
+
+    PointTable table;
+    table.layout()->registerDim(Dimension::Id::X);
+    PointViewPtr view(new PointView(table));
+    view->setField(Dimension::Id::X, 0, 1.0);
+
+    Script script(source, "MyTest", "yow");
+    Invocation meth(script, m, "");
+    EXPECT_TRUE(meth.execute(view, MetadataNode()));
+}
+
+
+TEST(PLangTest, PLangTest_returntrue)
+{
+    const char* source =
+        "import numpy as np\n"
+        "def yow(ins,outs):\n"
+        "  return True\n"
+        ;
+    Script script(source, "MyTest", "yow");
+    Invocation meth(script, MetadataNode(), "");
+
+    PointTable table;
+    PointViewPtr view(new PointView(table));
+
+    EXPECT_TRUE(meth.execute(view, MetadataNode()));
+}
+
+
+TEST(PLangTest, PLangTest_returnfalse)
+{
+    const char* source =
+        "import numpy as np\n"
+        "def yow(ins,outs):\n"
+        "  return False\n"
+        ;
+    Script script(source, "MyTest", "yow");
+    Invocation meth(script, MetadataNode(), "");
+
+    PointTable table;
+    PointViewPtr view(new PointView(table));
+    EXPECT_FALSE(meth.execute(view, MetadataNode()));
+}
+
+
+//---------------------------------------------------------------------------
+//
+// MISC tests
+//
+//---------------------------------------------------------------------------
+
+TEST(PLangTest, log)
+{
+    // verify we can redirect the stdout inside the python script
+
+    std::string logfile("mylog_three.txt");
+//    std::string logfile(Support::temppath("mylog_three.txt"));
+
+    Options reader_opts;
+    {
+        BOX3D bounds(1.0, 2.0, 3.0, 101.0, 102.0, 103.0);
+        Option opt1("bounds", bounds);
+        Option opt2("count", 750);
+        Option opt3("mode", "constant");
+
+        reader_opts.add(opt1);
+        reader_opts.add(opt2);
+        reader_opts.add(opt3);
+
+        Option optlog("log", logfile);
+        reader_opts.add(optlog);
+    }
+
+    Options xfilter_opts;
+    {
+        const Option source("source",
+            "import numpy as np\n"
+            "import sys\n"
+            "def xfunc(ins,outs):\n"
+            "  X = ins['X']\n"
+            "  print (\"Testing log output through python script.\")\n"
+            "  X = X + 1.0\n"
+            "  outs['X'] = X\n"
+            "  sys.stdout.flush()\n"
+            "  return True\n"
+            );
+        const Option module("module", "xModule");
+        const Option function("function", "xfunc");
+        xfilter_opts.add("log", logfile);
+        xfilter_opts.add(source);
+        xfilter_opts.add(module);
+        xfilter_opts.add(function);
+    }
+
+    StageFactory f;
+    {
+        FauxReader reader;
+
+        reader.setOptions(reader_opts);
+
+        Stage* xfilter(f.createStage("filters.python"));
+        xfilter->setOptions(xfilter_opts);
+        xfilter->setInput(reader);
+
+        PointTable table;
+        xfilter->prepare(table);
+        PointViewSet pvSet = xfilter->execute(table);
+        EXPECT_EQ(pvSet.size(), 1u);
+        PointViewPtr view = *pvSet.begin();
+        EXPECT_EQ(view->size(), 750u);
+    }
+
+    bool ok = Support::compare_text_files(logfile,
+        Support::datapath("logs/log_py.txt"));
+
+    // TODO: fails on Windows
+    // unknown file: error: C++ exception with description "pdalboost::filesystem::remove:
+    // The process cannot access the file because it is being used by another process:
+    // "C:/projects/pdal/test/data/../temp/mylog_three.txt"" thrown in the test body.
+    if (ok)
+        FileUtils::deleteFile(Support::temppath("mylog_three.txt"));
+
+    EXPECT_TRUE(ok);
+}
+
+
+TEST_F(PythonFilterTest, ErrorTest1)
+{
+    StageFactory f;
+
+    BOX3D bounds(0.0, 0.0, 0.0, 1.0, 1.0, 1.0);
+
+    Options ops;
+    ops.add("bounds", bounds);
+    ops.add("count", 10);
+    ops.add("mode", "ramp");
+
+    FauxReader reader;
+    reader.setOptions(ops);
+
+    Option source("source", "import numpy as np\n"
+        "def myfunc(ins,outs):\n"
+        "  X = ins['X']\n"
+        "  outs['FOO'] = X\n"
+        "  return True\n"
+    );
+    Option module("module", "MyModule");
+    Option function("function", "myfunc");
+    Options opts;
+    opts.add(source);
+    opts.add(module);
+    opts.add(function);
+
+    Stage* filter(f.createStage("filters.python"));
+    filter->setOptions(opts);
+    filter->setInput(reader);
+
+    PointTable table;
+
+    filter->prepare(table);
+    EXPECT_THROW(filter->execute(table), pdal_error);
+}
+
+
+TEST_F(PythonFilterTest, ErrorTest2)
+{
+    StageFactory f;
+
+    BOX3D bounds(0.0, 0.0, 0.0, 1.0, 1.0, 1.0);
+
+    Options ops;
+    ops.add("bounds", bounds);
+    ops.add("count", 10);
+    ops.add("mode", "ramp");
+
+    FauxReader reader;
+    reader.setOptions(ops);
+
+    Option source("source", "import numpy as np\n"
+        "def myfunc(ins,outs):\n"
+        "  X = ins['X']\n"
+        "  outs['Mask'] = X\n"
+        "  return True\n"
+    );
+    Option module("module", "MyModule");
+    Option function("function", "myfunc");
+    Options opts;
+    opts.add("module", "MyModule");
+    opts.add("function", "myfunc");
+    opts.add(source);
+
+    Stage* filter(f.createStage("filters.python"));
+    filter->setOptions(opts);
+    filter->setInput(reader);
+
+    PointTable table;
+
+    filter->prepare(table);
+    EXPECT_THROW(filter->execute(table), pdal_error);
+}
+
+
+TEST_F(PythonFilterTest, ErrorTest3)
+{
+    StageFactory f;
+
+    BOX3D bounds(0.0, 0.0, 0.0, 1.0, 1.0, 1.0);
+
+    Options ops;
+    ops.add("bounds", bounds);
+    ops.add("count", 10);
+    ops.add("mode", "ramp");
+
+    FauxReader reader;
+    reader.setOptions(ops);
+
+    Option source("source", "import numpy as np\n"
+        "def myfunc(ins,outs):\n"
+        "  X = ins['X']\n"
+        "  FOO = np.full([X.size + 1], True)\n"
+        "  outs['Mask'] = FOO\n"
+        "  return True\n"
+    );
+    Option module("module", "MyModule");
+    Option function("function", "myfunc");
+    Options opts;
+    opts.add("module", "MyModule");
+    opts.add("function", "myfunc");
+    opts.add(source);
+
+    Stage* filter(f.createStage("filters.python"));
+    filter->setOptions(opts);
+    filter->setInput(reader);
+
+    PointTable table;
+    filter->prepare(table);
+    EXPECT_THROW(filter->execute(table), pdal_error);
+}
+
+
+TEST_F(PythonFilterTest, ErrorTest4)
+{
+    StageFactory f;
+
+    BOX3D bounds(0.0, 0.0, 0.0, 1.0, 1.0, 1.0);
+
+    Options ops;
+    ops.add("bounds", bounds);
+    ops.add("count", 10);
+    ops.add("mode", "ramp");
+
+    FauxReader reader;
+    reader.setOptions(ops);
+
+    Option source("source", "import numpy as np\n"
+        "def myfunc(ins,outs):\n"
+        "  X = ins['X']\n"
+        "  FOO = np.full([X.size], True)\n"
+        "  outs['Mask'] = FOO\n"
+        "  outs['Y'] = ins['Y']\n"
+        "  return True\n"
+    );
+    Option module("module", "MyModule");
+    Option function("function", "myfunc");
+    Options opts;
+    opts.add("module", "MyModule");
+    opts.add("function", "myfunc");
+    opts.add(source);
+
+    Stage* filter(f.createStage("filters.python"));
+    filter->setOptions(opts);
+    filter->setInput(reader);
+
+    PointTable table;
+    filter->prepare(table);
+    EXPECT_THROW(filter->execute(table), pdal_error);
+}
+
+
+TEST_F(PythonFilterTest, ErrorTest5)
+{
+    Options opts;
+    opts.add("module", "MyModule");
+    opts.add("function", "f");
+
+    StageFactory f;
+    Stage *filter(f.createStage("filters.python"));
+    filter->setOptions(opts);
+
+    PointTable t;
+    EXPECT_THROW(filter->prepare(t), pdal_error);
+}
+
+
+TEST_F(PythonFilterTest, ErrorTest6)
+{
+    Options opts;
+    opts.add("module", "MyModule");
+    opts.add("function", "f");
+    opts.add("script", "some script");
+    opts.add("source", "some source");
+
+    StageFactory f;
+    Stage *filter(f.createStage("filters.python"));
+    filter->setOptions(opts);
+
+    PointTable t;
+    EXPECT_THROW(filter->prepare(t), pdal_error);
+}
+
+
+TEST_F(PythonFilterTest, PythonFilterTest_modify)
+{
+    StageFactory f;
+
+    BOX3D bounds(0.0, 0.0, 0.0, 1.0, 1.0, 1.0);
+
+    Options ops;
+    ops.add("bounds", bounds);
+    ops.add("count", 10);
+    ops.add("mode", "ramp");
+
+    FauxReader reader;
+    reader.setOptions(ops);
+
+    Option source("source", "import numpy as np\n"
+        "def myfunc(ins,outs):\n"
+        "  X = ins['X']\n"
+        "  Y = ins['Y']\n"
+        "  Z = ins['Z']\n"
+        "  X = np.delete(X, (9), axis=0)\n"
+        "  Y = np.delete(Y, (9), axis=0)\n"
+        "  Z = np.delete(Z, (9), axis=0)\n"
+        "  Z = np.append(Z,100)\n"
+        "  Y = np.append(Y,200)\n"
+        "#  print (Z)\n"
+        "#  print (X)\n"
+        "  outs['Z'] = Z\n"
+        "  outs['Y'] = Y\n"
+        "  outs['X'] = X\n"
+        "#  print (len(X), len(Y), len(Z))\n"
+        "  return True\n"
+    );
+    Option module("module", "MyModule");
+    Option function("function", "myfunc");
+    Options opts;
+    opts.add(source);
+    opts.add(module);
+    opts.add(function);
+
+    Stage* filter(f.createStage("filters.python"));
+    filter->setOptions(opts);
+    filter->setInput(reader);
+
+    std::unique_ptr<StatsFilter> stats(new StatsFilter);
+    stats->setInput(*filter);
+
+    PointTable table;
+
+    stats->prepare(table);
+    PointViewSet viewSet = stats->execute(table);
+    EXPECT_EQ(viewSet.size(), 1u);
+    PointViewPtr view = *viewSet.begin();
+
+    const stats::Summary& statsX = stats->getStats(Dimension::Id::X);
+    const stats::Summary& statsY = stats->getStats(Dimension::Id::Y);
+    const stats::Summary& statsZ = stats->getStats(Dimension::Id::Z);
+
+    EXPECT_EQ(view->size(), 10u);
+
+    EXPECT_DOUBLE_EQ(statsX.minimum(), 0.0);
+    EXPECT_DOUBLE_EQ(statsX.maximum(), 1.0);
+
+    EXPECT_DOUBLE_EQ(statsY.minimum(), 0.0);
+    EXPECT_DOUBLE_EQ(statsY.maximum(), 200.0);
+
+    EXPECT_DOUBLE_EQ(statsZ.minimum(), 0.0);
+    EXPECT_DOUBLE_EQ(statsZ.maximum(), 100);
+}
+
+
+TEST_F(PythonFilterTest, stream)
+{
+    StageFactory f;
+
+    BOX3D bounds(0.0, 0.0, 0.0, 24.0, 24.0, 24.0);
+
+    Options ops;
+    ops.add("bounds", bounds);
+    ops.add("count", 25);
+    ops.add("mode", "ramp");
+
+    FauxReader reader;
+    reader.setOptions(ops);
+
+    Options opts1;
+    opts1.add("source", "import numpy as np\n"
+        "def myfunc(ins,outs):\n"
+        "  assert len(ins['X']) <= 4\n"
+        "  outs['Z'] = ins['X'] * 2\n"
+        "  return True\n");
+    opts1.add("module", "MyModule");
+    opts1.add("function", "myfunc");
+    opts1.add("batch_size", 4);
+
+    Stage* filter1(f.createStage("filters.python"));
+    filter1->setOptions(opts1);
+    filter1->setInput(reader);
+
+    // Drops the odd points.
+    Options opts2;
+    opts2.add("source", "import numpy as np\n"
+        "def myfunc(ins,outs):\n"
+        "  outs['Mask'] = ins['X'] % 2 == 0\n"
+        "  return True\n");
+    opts2.add("module", "MyModule");
+    opts2.add("function", "myfunc");
+
+    Stage* filter2(f.createStage("filters.python"));
+    filter2->setOptions(opts2);
+    filter2->setInput(*filter1);
+
+    point_count_t count = 0;
+    StreamCallbackFilter cb;
+    cb.setCallback([&count](PointRef& point)
+    {
+        double x = point.getFieldAs<double>(Dimension::Id::X);
+        EXPECT_DOUBLE_EQ(x, 2.0 * count);
+        EXPECT_DOUBLE_EQ(point.getFieldAs<double>(Dimension::Id::Z), 2 * x);
+        count++;
+        return true;
+    });
+    cb.setInput(*filter2);
+
+    // The chunk size isn't a multiple of the batch size, so some batches
+    // end early.
+    FixedPointTable table(10);
+    cb.prepare(table);
+    cb.execute(table);
+    EXPECT_EQ(count, 13u);
+}
+
+// A batch mustn't outlive its chunk, even when the next chunk's first
+// point follows the last one seen.
+TEST_F(PythonFilterTest, stream_dropped)
+{
+    StageFactory f;
+
+    BOX3D bounds(0.0, 0.0, 0.0, 19.0, 19.0, 19.0);
+
+    Options ops;
+    ops.add("bounds", bounds);
+    ops.add("count", 20);
+    ops.add("mode", "ramp");
+
+    FauxReader reader;
+    reader.setOptions(ops);
+
+    // Keeps the head of the first chunk and one point of the second.
+    Options opts1;
+    opts1.add("source", "import numpy as np\n"
+        "def myfunc(ins,outs):\n"
+        "  outs['Mask'] = (ins['X'] < 5) | (ins['X'] == 15)\n"
+        "  return True\n");
+    opts1.add("module", "MyModule");
+    opts1.add("function", "myfunc");
+
+    Stage* filter1(f.createStage("filters.python"));
+    filter1->setOptions(opts1);
+    filter1->setInput(reader);
+
+    // Dropped points aren't passed to the next function.
+    Options opts2;
+    opts2.add("source", "import numpy as np\n"
         "def myfunc(ins,outs):\n"
-        "  X = ins['X']\n"
-        "  FOO = np.full([X.size + 1], True)\n"
-        "  outs['Mask'] = FOO\n"
-        "  return True\n"
-    );
-    Option module("module", "MyModule");
-    Option function("function", "myfunc");
+        "  if np.any((ins['X'] >= 5) & (ins['X'] != 15)):\n"
+        "    raise ValueError('dropped point passed')\n"
+        "  outs['Z'] = ins['X'] * 2\n"
+        "  return True\n");
+    opts2.add("module", "MyModule");
+    opts2.add("function", "myfunc");
+    opts2.add("batch_size", 6);
+
+    Stage* filter2(f.createStage("filters.python"));
+    filter2->setOptions(opts2);
+    filter2->setInput(*filter1);
+
+    std::vector<double> xs;
+    StreamCallbackFilter cb;
+    cb.setCallback([&xs](PointRef& point)
+    {
+        double x = point.getFieldAs<double>(Dimension::Id::X);
+        EXPECT_DOUBLE_EQ(point.getFieldAs<double>(Dimension::Id::Z), 2 * x);
+        xs.push_back(x);
+        return true;
+    });
+    cb.setInput(*filter2);
+
+    FixedPointTable table(10);
+    cb.prepare(table);
+    cb.execute(table);
+    EXPECT_EQ(xs, std::vector<double>({ 0, 1, 2, 3, 4, 15 }));
+}
+
+TEST_F(PythonFilterTest, chunk_size)
+{
+    StageFactory f;
+
+    BOX3D bounds(0.0, 0.0, 0.0, 24.0, 24.0, 24.0);
+
+    Options ops;
+    ops.add("bounds", bounds);
+    ops.add("count", 25);
+    ops.add("mode", "ramp");
+
+    FauxReader reader;
+    reader.setOptions(ops);
+
+    Options opts1;
+    opts1.add("source", "import numpy as np\n"
+        "def myfunc(ins,outs):\n"
+        "  assert len(ins['X']) <= 10\n"
+        "  outs['Z'] = ins['X'] * 2\n"
+        "  return True\n");
+    opts1.add("module", "MyModule");
+    opts1.add("function", "myfunc");
+    opts1.add("chunk_size", 10);
+
+    Stage* filter1(f.createStage("filters.python"));
+    filter1->setOptions(opts1);
+    filter1->setInput(reader);
+
+    // Each chunk of 7 points has every label, but the views are
+    // combined by label.
+    Options opts2;
+    opts2.add("source", "import numpy as np\n"
+        "def myfunc(ins,outs):\n"
+        "  outs['Split'] = (ins['X'] % 3).astype(np.int64)\n"
+        "  return True\n");
+    opts2.add("module", "MyModule");
+    opts2.add("function", "myfunc");
+    opts2.add("chunk_size", 7);
+
+    Stage* filter2(f.createStage("filters.python"));
+    filter2->setOptions(opts2);
+    filter2->setInput(*filter1);
+
+    PointTable table;
+    filter2->prepare(table);
+    PointViewSet viewSet = filter2->execute(table);
+    ASSERT_EQ(viewSet.size(), 3u);
+
+    const point_count_t sizes[] = { 9, 8, 8 };
+    int label = 0;
+    for (const PointViewPtr& view : viewSet)
+    {
+        ASSERT_EQ(view->size(), sizes[label]);
+        for (PointId i = 0; i < view->size(); ++i)
+        {
+            double x = view->getFieldAs<double>(Dimension::Id::X, i);
+            EXPECT_DOUBLE_EQ(x, 3.0 * i + label);
+            EXPECT_DOUBLE_EQ(
+                view->getFieldAs<double>(Dimension::Id::Z, i), 2 * x);
+        }
+        label++;
+    }
+}
+
+TEST_F(PythonFilterTest, workers)
+{
+    StageFactory f;
+
+    BOX3D bounds(0.0, 0.0, 0.0, 999.0, 999.0, 999.0);
+
+    Options ops;
+    ops.add("bounds", bounds);
+    ops.add("count", 1000);
+    ops.add("mode", "ramp");
+
+    FauxReader reader;
+    reader.setOptions(ops);
+
     Options opts;
+    opts.add("source", "import numpy as np\n"
+        "def myfunc(ins,outs):\n"
+        "  outs['Mask'] = ins['X'] % 2 == 0\n"
+        "  return True\n");
     opts.add("module", "MyModule");
     opts.add("function", "myfunc");
-    opts.add(source);
+    opts.add("chunk_size", 100);
+    opts.add("workers", 4);
 
     Stage* filter(f.createStage("filters.python"));
     filter->setOptions(opts);
@@ -965,38 +1828,46 @@ TEST_F(PythonFilterTest, ErrorTest3)
 
     PointTable table;
     filter->prepare(table);
-    EXPECT_THROW(filter->execute(table), pdal_error);
-}
+    PointViewSet viewSet = filter->execute(table);
+    ASSERT_EQ(viewSet.size(), 1u);
 
+    // The slices are combined in order, whichever worker ran them.
+    PointViewPtr view = *viewSet.begin();
+    ASSERT_EQ(view->size(), 500u);
+    for (PointId i = 0; i < view->size(); ++i)
+        EXPECT_DOUBLE_EQ(view->getFieldAs<double>(Dimension::Id::X, i),
+            2.0 * i);
+}
 
-TEST_F(PythonFilterTest, ErrorTest4)
+// Each slice's 'out_metadata' is the one its own call set, even though
+// the workers share the module.
+TEST_F(PythonFilterTest, workers_metadata)
 {
     StageFactory f;
 
-    BOX3D bounds(0.0, 0.0, 0.0, 1.0, 1.0, 1.0);
+    BOX3D bounds(0.0, 0.0, 0.0, 999.0, 999.0, 999.0);
 
     Options ops;
     ops.add("bounds", bounds);
-    ops.add("count", 10);
+    ops.add("count", 1000);
     ops.add("mode", "ramp");
 
     FauxReader reader;
     reader.setOptions(ops);
 
-    Option source("source", "import numpy as np\n"
-        "def myfunc(ins,outs):\n"
-        "  X = ins['X']\n"
-        "  FOO = np.full([X.size], True)\n"
-        "  outs['Mask'] = FOO\n"
-        "  outs['Y'] = ins['Y']\n"
-        "  return True\n"
-    );
-    Option module("module", "MyModule");
-    Option function("function", "myfunc");
     Options opts;
+    opts.add("source", "import numpy as np\n"
+        "def myfunc(ins,outs):\n"
+        "  global out_metadata\n"
+        "  first = int(ins['X'][0])\n"
+        "  out_metadata = {'name': 'slice', 'value': first, "
+            "'type': 'integer', 'description': '', 'children': []}\n"
+        "  outs['Y'] = ins['X'] * 2\n"
+        "  return True\n");
     opts.add("module", "MyModule");
     opts.add("function", "myfunc");
-    opts.add(source);
+    opts.add("chunk_size", 100);
+    opts.add("workers", 4);
 
     Stage* filter(f.createStage("filters.python"));
     filter->setOptions(opts);
@@ -1004,111 +1875,350 @@ TEST_F(PythonFilterTest, ErrorTest4)
 
     PointTable table;
     filter->prepare(table);
-    EXPECT_THROW(filter->execute(table), pdal_error);
+    filter->execute(table);
+
+    std::vector<int> firsts;
+    MetadataNode m = table.metadata().findChild("filters.python");
+    for (MetadataNode& child : m.children())
+        if (child.name() == "slice")
+            firsts.push_back(std::stoi(child.value()));
+    std::sort(firsts.begin(), firsts.end());
+    ASSERT_EQ(firsts.size(), 10u);
+    for (size_t i = 0; i < firsts.size(); ++i)
+        EXPECT_EQ(firsts[i], (int)(100 * i));
 }
 
-
-TEST_F(PythonFilterTest, ErrorTest5)
+#ifdef Py_GIL_DISABLED
+// Loading the script and the redirector doesn't turn the GIL back on, so
+// the workers' calls can run at the same time.
+TEST_F(PythonFilterTest, workers_free_threaded)
 {
+    StageFactory f;
+
+    BOX3D bounds(0.0, 0.0, 0.0, 999.0, 999.0, 999.0);
+
+    Options ops;
+    ops.add("bounds", bounds);
+    ops.add("count", 1000);
+    ops.add("mode", "ramp");
+
+    FauxReader reader;
+    reader.setOptions(ops);
+
     Options opts;
+    opts.add("source", "import numpy as np\n"
+        "import sys\n"
+        "def myfunc(ins,outs):\n"
+        "  gil = 1 if sys._is_gil_enabled() else 0\n"
+        "  outs['Y'] = ins['X'] * 2 + gil\n"
+        "  return True\n");
     opts.add("module", "MyModule");
-    opts.add("function", "f");
+    opts.add("function", "myfunc");
+    opts.add("chunk_size", 100);
+    opts.add("workers", 4);
 
-    StageFactory f;
-    Stage *filter(f.createStage("filters.python"));
+    Stage* filter(f.createStage("filters.python"));
     filter->setOptions(opts);
+    filter->setInput(reader);
 
-    PointTable t;
-    EXPECT_THROW(filter->prepare(t), pdal_error);
-}
+    PointTable table;
+    filter->prepare(table);
+    PointViewSet viewSet = filter->execute(table);
+    ASSERT_EQ(viewSet.size(), 1u);
 
+    PointViewPtr view = *viewSet.begin();
+    ASSERT_EQ(view->size(), 1000u);
+    for (PointId i = 0; i < view->size(); ++i)
+        EXPECT_DOUBLE_EQ(view->getFieldAs<double>(Dimension::Id::Y, i),
+            2.0 * i);
+}
+#endif
 
-TEST_F(PythonFilterTest, ErrorTest6)
+TEST_F(PythonFilterTest, executor)
 {
+    StageFactory f;
+
+    BOX3D bounds(0.0, 0.0, 0.0, 99.0, 99.0, 99.0);
+
+    Options ops;
+    ops.add("bounds", bounds);
+    ops.add("count", 100);
+    ops.add("mode", "ramp");
+
+    FauxReader reader;
+    reader.setOptions(ops);
+
     Options opts;
+    opts.add("source", "import numpy as np\n"
+        "def myfunc(ins,outs):\n"
+        "  outs['Y'] = ins['X'] * 2\n"
+        "  return True\n");
     opts.add("module", "MyModule");
-    opts.add("function", "f");
-    opts.add("script", "some script");
-    opts.add("source", "some source");
+    opts.add("function", "myfunc");
+    opts.add("executor", true);
 
-    StageFactory f;
-    Stage *filter(f.createStage("filters.python"));
+    Stage* filter(f.createStage("filters.python"));
     filter->setOptions(opts);
+    filter->setInput(reader);
 
-    PointTable t;
-    EXPECT_THROW(filter->prepare(t), pdal_error);
+    PointTable table;
+    filter->prepare(table);
+    PointViewSet viewSet = filter->execute(table);
+    ASSERT_EQ(viewSet.size(), 1u);
+
+    PointViewPtr view = *viewSet.begin();
+    ASSERT_EQ(view->size(), 100u);
+    for (PointId i = 0; i < view->size(); ++i)
+        EXPECT_DOUBLE_EQ(view->getFieldAs<double>(Dimension::Id::Y, i),
+            2.0 * i);
 }
 
+TEST_F(PythonFilterTest, bytecode_cache)
+{
+    StageFactory f;
+
+    BOX3D bounds(0.0, 0.0, 0.0, 9.0, 9.0, 9.0);
 
-TEST_F(PythonFilterTest, PythonFilterTest_modify)
+    Options ops;
+    ops.add("bounds", bounds);
+    ops.add("count", 10);
+    ops.add("mode", "ramp");
+
+    const std::string cacheDir(Support::temppath("python_code_cache"));
+    FileUtils::deleteDirectory(cacheDir);
+
+    const std::string source("import numpy as np\n"
+        "def myfunc(ins,outs):\n"
+        "  outs['Y'] = ins['X'] * 3\n"
+        "  return True\n");
+    const std::string module("MyCachedModule");
+
+    // Returns the ratio of Y to X that the function set.
+    auto run = [&](bool isolated)
+    {
+        FauxReader reader;
+        reader.setOptions(ops);
+
+        Options opts;
+        opts.add("source", source);
+        opts.add("module", module);
+        opts.add("function", "myfunc");
+        opts.add("bytecode_cache", cacheDir);
+        opts.add("isolated", isolated);
+
+        Stage* filter(f.createStage("filters.python"));
+        filter->setOptions(opts);
+        filter->setInput(reader);
+
+        PointTable table;
+        filter->prepare(table);
+        PointViewSet viewSet = filter->execute(table);
+        PointViewPtr view = *viewSet.begin();
+        EXPECT_EQ(view->size(), 10u);
+        return view->getFieldAs<double>(Dimension::Id::Y, 1) /
+            view->getFieldAs<double>(Dimension::Id::X, 1);
+    };
+
+    // The first run compiles the code and caches it.
+    EXPECT_DOUBLE_EQ(run(false), 3.0);
+    std::vector<std::string> entries = FileUtils::directoryList(cacheDir);
+    ASSERT_EQ(entries.size(), 1u);
+
+    // The cached code is replaced with code for a different function.
+    // Each entry starts with a key that ends with the source and module
+    // name.
+    {
+        pdal::plang::Environment::get();
+        pdal::plang::gil_scoped_acquire acquire;
+
+        std::string data = FileUtils::readFileIntoString(entries[0]);
+        size_t keySize = data.find(source) + source.size() + module.size();
+        PyObject *code = Py_CompileString("import numpy as np\n"
+            "def myfunc(ins,outs):\n"
+            "  outs['Y'] = ins['X'] * 5\n"
+            "  return True\n", module.c_str(), Py_file_input);
+        ASSERT_TRUE(code);
+        PyObject *bytes = PyMarshal_WriteObjectToString(code,
+            Py_MARSHAL_VERSION);
+        Py_DECREF(code);
+        ASSERT_TRUE(bytes);
+        data = data.substr(0, keySize) +
+            std::string(PyBytes_AS_STRING(bytes), PyBytes_GET_SIZE(bytes));
+        Py_DECREF(bytes);
+
+        std::ofstream out(entries[0], std::ios::binary);
+        out << data;
+    }
+
+    // An isolated module isn't shared with the first run, so its code
+    // can only have come from the cache.
+    EXPECT_DOUBLE_EQ(run(true), 5.0);
+    FileUtils::deleteDirectory(cacheDir);
+}
+
+TEST_F(PythonFilterTest, shared_module)
 {
     StageFactory f;
 
-    BOX3D bounds(0.0, 0.0, 0.0, 1.0, 1.0, 1.0);
+    BOX3D bounds(0.0, 0.0, 0.0, 9.0, 9.0, 9.0);
 
     Options ops;
     ops.add("bounds", bounds);
     ops.add("count", 10);
     ops.add("mode", "ramp");
 
+    // Returns the number of times the module's top-level code has run.
+    auto run = [&](bool isolated)
+    {
+        FauxReader reader;
+        reader.setOptions(ops);
+
+        Options opts;
+        opts.add("source", "import builtins\n"
+            "builtins.shared_runs = getattr(builtins, 'shared_runs', 0) + 1\n"
+            "def myfunc(ins,outs):\n"
+            "  outs['Y'] = ins['X'] * 0 + shared_runs\n"
+            "  return True\n");
+        opts.add("module", "MySharedModule");
+        opts.add("function", "myfunc");
+        opts.add("isolated", isolated);
+
+        Stage* filter(f.createStage("filters.python"));
+        filter->setOptions(opts);
+        filter->setInput(reader);
+
+        PointTable table;
+        filter->prepare(table);
+        PointViewSet viewSet = filter->execute(table);
+        PointViewPtr view = *viewSet.begin();
+        return view->getFieldAs<int>(Dimension::Id::Y, 0);
+    };
+
+    int runs = run(false);
+    EXPECT_EQ(run(false), runs);
+    EXPECT_EQ(run(true), runs + 1);
+}
+
+TEST_F(PythonFilterTest, processes)
+{
+    StageFactory f;
+
+    BOX3D bounds(0.0, 0.0, 0.0, 999.0, 999.0, 999.0);
+
+    Options ops;
+    ops.add("bounds", bounds);
+    ops.add("count", 1000);
+    ops.add("mode", "ramp");
+
     FauxReader reader;
     reader.setOptions(ops);
 
-    Option source("source", "import numpy as np\n"
+    Options opts1;
+    opts1.add("source", "import numpy as np\n"
         "def myfunc(ins,outs):\n"
-        "  X = ins['X']\n"
-        "  Y = ins['Y']\n"
-        "  Z = ins['Z']\n"
-        "  X = np.delete(X, (9), axis=0)\n"
-        "  Y = np.delete(Y, (9), axis=0)\n"
-        "  Z = np.delete(Z, (9), axis=0)\n"
-        "  Z = np.append(Z,100)\n"
-        "  Y = np.append(Y,200)\n"
-        "#  print (Z)\n"
-        "#  print (X)\n"
-        "  outs['Z'] = Z\n"
-        "  outs['Y'] = Y\n"
-        "  outs['X'] = X\n"
-        "#  print (len(X), len(Y), len(Z))\n"
-        "  return True\n"
-    );
-    Option module("module", "MyModule");
-    Option function("function", "myfunc");
-    Options opts;
-    opts.add(source);
-    opts.add(module);
-    opts.add(function);
+        "  outs['Y'] = ins['X'] * 2\n"
+        "  return True\n");
+    opts1.add("module", "MyModule");
+    opts1.add("function", "myfunc");
+    opts1.add("chunk_size", 100);
+    opts1.add("processes", 3);
 
-    Stage* filter(f.createStage("filters.python"));
-    filter->setOptions(opts);
-    filter->setInput(reader);
+    Stage* filter1(f.createStage("filters.python"));
+    filter1->setOptions(opts1);
+    filter1->setInput(reader);
 
-    std::unique_ptr<StatsFilter> stats(new StatsFilter);
-    stats->setInput(*filter);
+    Options opts2;
+    opts2.add("source", "import numpy as np\n"
+        "def myfunc(ins,outs):\n"
+        "  outs['Mask'] = ins['X'] % 2 == 0\n"
+        "  return True\n");
+    opts2.add("module", "MyModule");
+    opts2.add("function", "myfunc");
+    opts2.add("chunk_size", 100);
+    opts2.add("processes", 3);
+
+    Stage* filter2(f.createStage("filters.python"));
+    filter2->setOptions(opts2);
+    filter2->setInput(*filter1);
 
     PointTable table;
+    filter2->prepare(table);
+    PointViewSet viewSet = filter2->execute(table);
+    ASSERT_EQ(viewSet.size(), 1u);
 
-    stats->prepare(table);
-    PointViewSet viewSet = stats->execute(table);
-    EXPECT_EQ(viewSet.size(), 1u);
     PointViewPtr view = *viewSet.begin();
+    ASSERT_EQ(view->size(), 500u);
+    for (PointId i = 0; i < view->size(); ++i)
+    {
+        EXPECT_DOUBLE_EQ(view->getFieldAs<double>(Dimension::Id::X, i),
+            2.0 * i);
+        EXPECT_DOUBLE_EQ(view->getFieldAs<double>(Dimension::Id::Y, i),
+            4.0 * i);
+    }
+}
 
-    const stats::Summary& statsX = stats->getStats(Dimension::Id::X);
-    const stats::Summary& statsY = stats->getStats(Dimension::Id::Y);
-    const stats::Summary& statsZ = stats->getStats(Dimension::Id::Z);
+// The processes are forked once and used for every view.
+TEST_F(PythonFilterTest, processes_reused)
+{
+    StageFactory f;
 
-    EXPECT_EQ(view->size(), 10u);
+    BOX3D bounds(0.0, 0.0, 0.0, 999.0, 999.0, 999.0);
 
-    EXPECT_DOUBLE_EQ(statsX.minimum(), 0.0);
-    EXPECT_DOUBLE_EQ(statsX.maximum(), 1.0);
+    Options ops;
+    ops.add("bounds", bounds);
+    ops.add("count", 1000);
+    ops.add("mode", "ramp");
 
-    EXPECT_DOUBLE_EQ(statsY.minimum(), 0.0);
-    EXPECT_DOUBLE_EQ(statsY.maximum(), 200.0);
+    FauxReader reader;
+    reader.setOptions(ops);
 
-    EXPECT_DOUBLE_EQ(statsZ.minimum(), 0.0);
-    EXPECT_DOUBLE_EQ(statsZ.maximum(), 100);
-}
+    Options opts1;
+    opts1.add("source", "import numpy as np\n"
+        "def myfunc(ins,outs):\n"
+        "  outs['Split'] = (ins['X'] % 4).astype(np.int64)\n"
+        "  return True\n");
+    opts1.add("module", "MyModule");
+    opts1.add("function", "myfunc");
+
+    Stage* filter1(f.createStage("filters.python"));
+    filter1->setOptions(opts1);
+    filter1->setInput(reader);
+
+    Options opts2;
+    opts2.add("source", "import numpy as np\n"
+        "import os\n"
+        "def myfunc(ins,outs):\n"
+        "  global out_metadata\n"
+        "  out_metadata = {'name': 'pid', 'value': str(os.getpid()), "
+            "'type': 'string', 'description': '', 'children': []}\n"
+        "  outs['Y'] = ins['X'] * 2\n"
+        "  return True\n");
+    opts2.add("module", "MyModule");
+    opts2.add("function", "myfunc");
+    opts2.add("chunk_size", 50);
+    opts2.add("processes", 2);
+
+    Stage* filter2(f.createStage("filters.python"));
+    filter2->setOptions(opts2);
+    filter2->setInput(*filter1);
 
+    PointTable table;
+    filter2->prepare(table);
+    PointViewSet viewSet = filter2->execute(table);
+    ASSERT_EQ(viewSet.size(), 4u);
+    for (const PointViewPtr& view : viewSet)
+        for (PointId i = 0; i < view->size(); ++i)
+            EXPECT_DOUBLE_EQ(view->getFieldAs<double>(Dimension::Id::Y, i),
+                2 * view->getFieldAs<double>(Dimension::Id::X, i));
+
+    std::vector<std::string> pids;
+    for (MetadataNode& child : filter2->getMetadata().children())
+        if (child.name() == "pid")
+            pids.push_back(child.value());
+    std::sort(pids.begin(), pids.end());
+    pids.erase(std::unique(pids.begin(), pids.end()), pids.end());
+    EXPECT_EQ(pids.size(), 2u);
+}
 
 // most pipelines (those with a writer) will be invoked via `pdal pipeline`
 static void run_pipeline(std::string const& pipeline)